@@ -0,0 +1,85 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#ifndef MIPS_ASM_BENCH_HPP
+#define MIPS_ASM_BENCH_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace as::bench {
+
+/**
+ * A single benchmark, run() is timed and is expected to process `units` units of work per call
+ */
+struct bench_case {
+    std::string name;
+    std::string unit;
+    std::function<std::size_t()> run;
+};
+
+/**
+ * @return All benchmarks that have been registered via registrar
+ */
+inline std::vector<bench_case>& registry() {
+    static std::vector<bench_case> cases;
+    return cases;
+}
+
+/**
+ * Register a benchmark at static initialization time
+ */
+struct registrar {
+    registrar(const std::string& name, const std::string& unit, std::function<std::size_t()> run) {
+        registry().push_back({name, unit, std::move(run)});
+    }
+};
+
+/**
+ * Stop the compiler from optimizing away a computed value
+ */
+template <typename T>
+inline void keep(const T& value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+/**
+ * Time a benchmark case, repeating it until at least min_seconds have elapsed
+ * @return units processed per second
+ */
+inline double measure(const bench_case& bc, double min_seconds = 0.5) {
+    using clock = std::chrono::steady_clock;
+
+    // warm up, this also builds any inputs the case creates on first use
+    bc.run();
+
+    std::size_t units = 0;
+    auto start = clock::now();
+    std::chrono::duration<double> elapsed{};
+
+    do {
+        units += bc.run();
+        elapsed = clock::now() - start;
+    } while(elapsed.count() < min_seconds);
+
+    return static_cast<double>(units) / elapsed.count();
+}
+
+/**
+ * Print a result line
+ */
+inline void report(const bench_case& bc, double per_second) {
+    std::cout << std::left << std::setw(48) << bc.name
+              << std::right << std::setw(16) << std::fixed << std::setprecision(0) << per_second
+              << " " << bc.unit << "/s" << std::endl;
+}
+
+}
+
+#endif //MIPS_ASM_BENCH_HPP
@@ -0,0 +1,225 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#include <string>
+#include <vector>
+#include "bench.hpp"
+#include "emitter/emitter.hpp"
+#include "emitter/encode.hpp"
+#include "emitter/op_sequences.hpp"
+#include "lexer/lexer.hpp"
+
+namespace {
+
+const std::string sample_source =
+    "main:\n"
+    "add $t0, $t1, $t2\n"
+    "addi $t0, $t0, 100\n"
+    "lw $t1, 4($sp)\n"
+    "sub $s0, $s1, $s2\n"
+    "j main\n";
+
+const as::token_stream& tokens_1mb() {
+    static const as::token_stream tokens = [] {
+        std::string src;
+
+        while(src.size() < (1 << 20)) {
+            src += sample_source;
+        }
+
+        as::lexer lexer;
+        return std::move(lexer.lex(src).value());
+    }();
+
+    return tokens;
+}
+
+// the same tokens with their labels, mnemonics and directives interned, as main lexes them
+const as::token_stream& interned_tokens_1mb() {
+    static as::interner symbols;
+    static const as::token_stream tokens = [] {
+        std::string src;
+
+        while(src.size() < (1 << 20)) {
+            src += sample_source;
+        }
+
+        as::lexer lexer;
+        return std::move(lexer.lex(src, as::attribute_storage::OWNED, &symbols).value());
+    }();
+
+    return tokens;
+}
+
+// the tokens as token objects, how they were stored before token_stream
+const std::vector<as::token>& token_vector_1mb() {
+    static const std::vector<as::token> tokens(tokens_1mb().begin(), tokens_1mb().end());
+    return tokens;
+}
+
+// split into statement buffers by visiting every token, as emit did before token_stream
+as::bench::registrar split_vector("emitter/split statements vector<token>", "tokens", [] {
+    auto& tokens = token_vector_1mb();
+    std::vector<as::token> token_buffer;
+    std::size_t buffered = 0;
+
+    for(auto& tk : tokens) {
+        if(tk.type() != as::token_type::NEW_LINE) {
+            token_buffer.emplace_back(tk);
+        } else {
+            buffered += token_buffer.size();
+            token_buffer.clear();
+        }
+    }
+
+    as::bench::keep(buffered);
+    return tokens.size();
+});
+
+// find the ends of statements by scanning the types
+as::bench::registrar find_stream("emitter/find statements token_stream", "tokens", [] {
+    auto& tokens = tokens_1mb();
+    std::size_t statements = 0;
+
+    for(std::size_t begin = 0; begin < tokens.size(); ++statements) {
+        begin = tokens.find(as::token_type::NEW_LINE, begin) + 1;
+    }
+
+    as::bench::keep(statements);
+    return tokens.size();
+});
+
+// match every statement to its operation sequence, as encode does
+as::bench::registrar match_sequences("emitter/match statements to op_sequences", "tokens", [] {
+    auto& tokens = tokens_1mb();
+    std::size_t matched = 0;
+    as::op_signature signature;
+
+    for(std::size_t i = 0; i < tokens.size(); ++i) {
+        if(tokens.type(i) != as::token_type::NEW_LINE) {
+            signature.push(tokens.type(i));
+        } else {
+            matched += as::op_sequences::find(signature) != nullptr;
+            signature = { };
+        }
+    }
+
+    as::bench::keep(matched);
+    return tokens.size();
+});
+
+// the statements of the 1MB source that encode, as encode takes them
+const std::vector<std::vector<as::token>>& instructions_1mb() {
+    static const std::vector<std::vector<as::token>> instructions = [] {
+        std::vector<std::vector<as::token>> statements(1);
+
+        for(auto& tk : token_vector_1mb()) {
+            if(tk.type() != as::token_type::NEW_LINE) {
+                statements.back().emplace_back(tk);
+            } else if(as::encode_instruction(statements.back(), { {"main", 0} }).has_value()) {
+                statements.emplace_back();
+            } else {
+                statements.back().clear();
+            }
+        }
+
+        statements.pop_back();
+        return statements;
+    }();
+
+    return instructions;
+}
+
+as::bench::registrar encode_instructions("emitter/encode instructions", "instructions", [] {
+    static const std::unordered_map<std::string, std::uint32_t> labels = { {"main", 0} };
+    auto& instructions = instructions_1mb();
+    std::uint32_t encoded = 0;
+
+    for(auto& instruction : instructions) {
+        encoded ^= as::encode_instruction(instruction, labels).value_or(0);
+    }
+
+    as::bench::keep(encoded);
+    return instructions.size();
+});
+
+// the [begin, end) of each instruction in the 1MB token stream, as the emitter finds them
+const std::vector<std::pair<std::size_t, std::size_t>>& statement_ranges_1mb() {
+    static const std::vector<std::pair<std::size_t, std::size_t>> ranges = [] {
+        auto& tokens = tokens_1mb();
+        std::vector<std::pair<std::size_t, std::size_t>> out;
+
+        for(std::size_t begin = 0; begin < tokens.size(); ) {
+            auto end = tokens.find(as::token_type::NEW_LINE, begin);
+
+            if(end != begin && tokens.type(begin) == as::token_type::MNEMONIC) {
+                out.emplace_back(begin, end);
+            }
+
+            begin = end + 1;
+        }
+
+        return out;
+    }();
+
+    return ranges;
+}
+
+// encoded in place with the statement's plan, as emit() does
+as::bench::registrar encode_statements("emitter/encode_statement token_stream", "instructions", [] {
+    auto& tokens = tokens_1mb();
+    auto& ranges = statement_ranges_1mb();
+    std::uint32_t encoded = 0;
+
+    for(auto& [begin, end] : ranges) {
+        const as::encoding_plan* unresolved = nullptr;
+
+        auto words = as::encode_statement(tokens, begin, end, 0x4000f0, [](std::size_t) {
+            return std::optional<std::uint32_t>(0x4000f0);
+        }, unresolved);
+
+        encoded ^= words.has_value() ? words.value().words[0] : 0;
+    }
+
+    as::bench::keep(encoded);
+    return ranges.size();
+});
+
+as::bench::registrar emit_tokens("emitter/emit 1MB of source", "tokens", [] {
+    auto binary = as::emit(tokens_1mb());
+    as::bench::keep(binary);
+    return tokens_1mb().size();
+});
+
+as::bench::registrar emit_interned_tokens("emitter/emit 1MB of interned source", "tokens", [] {
+    auto binary = as::emit(interned_tokens_1mb());
+    as::bench::keep(binary);
+    return interned_tokens_1mb().size();
+});
+
+as::bench::registrar emit_parallel_tokens("emitter/emit_parallel 1MB of source", "tokens", [] {
+    auto binary = as::emit_parallel(tokens_1mb());
+    as::bench::keep(binary);
+    return tokens_1mb().size();
+});
+
+as::bench::registrar emit_single_thread("emitter/emit_parallel 1MB of source, 1 thread", "tokens", [] {
+    auto binary = as::emit_parallel(tokens_1mb(), 1);
+    as::bench::keep(binary);
+    return tokens_1mb().size();
+});
+
+as::bench::registrar emit_two_threads("emitter/emit_parallel 1MB of source, 2 threads", "tokens", [] {
+    auto binary = as::emit_parallel(tokens_1mb(), 2);
+    as::bench::keep(binary);
+    return tokens_1mb().size();
+});
+
+as::bench::registrar emit_four_threads("emitter/emit_parallel 1MB of source, 4 threads", "tokens", [] {
+    auto binary = as::emit_parallel(tokens_1mb(), 4);
+    as::bench::keep(binary);
+    return tokens_1mb().size();
+});
+
+}
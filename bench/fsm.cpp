@@ -0,0 +1,132 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#include <string>
+#include "bench.hpp"
+#include "fsm/finite_state_machine.hpp"
+#include "fsm/static_finite_state_machine.hpp"
+
+namespace {
+
+// A small word/number/comment scanner, expressed with the same predicates and callbacks
+// for both the runtime and compile time state machines
+enum class scan_states {
+    BASE,
+    WORD,
+    NUMBER,
+    COMMENT
+};
+
+struct scan_input {
+    char ch;
+    std::size_t words = 0;
+    std::size_t numbers = 0;
+};
+
+bool is_alpha(scan_input& in)    { return (in.ch >= 'a' && in.ch <= 'z') || (in.ch >= 'A' && in.ch <= 'Z'); }
+bool is_digit(scan_input& in)    { return in.ch >= '0' && in.ch <= '9'; }
+bool is_hash(scan_input& in)     { return in.ch == '#'; }
+bool is_new_line(scan_input& in) { return in.ch == '\n'; }
+bool is_end(scan_input& in)      { return in.ch == ' ' || in.ch == ',' || in.ch == '\n'; }
+
+void count_word(scan_input& in)   { in.words++; }
+void count_number(scan_input& in) { in.numbers++; }
+
+using s = scan_states;
+
+using static_scanner = as::static_finite_state_machine<scan_states, scan_input,
+    as::static_transition<s::BASE, s::WORD, &is_alpha>,
+    as::static_transition<s::BASE, s::NUMBER, &is_digit>,
+    as::static_transition<s::BASE, s::COMMENT, &is_hash>,
+    as::static_transition<s::WORD, s::WORD, &is_alpha>,
+    as::static_transition<s::WORD, s::BASE, &is_end, &count_word>,
+    as::static_transition<s::NUMBER, s::NUMBER, &is_digit>,
+    as::static_transition<s::NUMBER, s::BASE, &is_end, &count_number>,
+    as::static_transition<s::COMMENT, s::BASE, &is_new_line>
+>;
+
+// the same, but comments are skipped to their newline when run()
+using static_skipping_scanner = as::static_finite_state_machine<scan_states, scan_input,
+    as::static_transition<s::BASE, s::WORD, &is_alpha>,
+    as::static_transition<s::BASE, s::NUMBER, &is_digit>,
+    as::static_transition<s::BASE, s::COMMENT, &is_hash>,
+    as::static_transition<s::WORD, s::WORD, &is_alpha>,
+    as::static_transition<s::WORD, s::BASE, &is_end, &count_word>,
+    as::static_transition<s::NUMBER, s::NUMBER, &is_digit>,
+    as::static_transition<s::NUMBER, s::BASE, &is_end, &count_number>,
+    as::static_transition<s::COMMENT, s::BASE, &is_new_line>,
+    as::static_skip<s::COMMENT, &as::skip_to<'\n'>>
+>;
+
+// the machine can't be copied or moved, so the transitions are added where it's constructed
+struct runtime_scanner : as::finite_state_machine<scan_states, scan_input> {
+    runtime_scanner() :
+        finite_state_machine(s::BASE)
+    {
+        add_transitions({
+            { s::BASE, s::WORD, is_alpha },
+            { s::BASE, s::NUMBER, is_digit },
+            { s::BASE, s::COMMENT, is_hash },
+            { s::WORD, s::WORD, is_alpha },
+            { s::WORD, s::BASE, is_end, count_word },
+            { s::NUMBER, s::NUMBER, is_digit },
+            { s::NUMBER, s::BASE, is_end, count_number },
+            { s::COMMENT, s::BASE, is_new_line }
+        });
+    }
+};
+
+const std::string& scan_source() {
+    static const std::string src = [] {
+        const std::string line = "add t0, t1, 100 # a comment\nlabel 42, word\n";
+        std::string out;
+
+        while(out.size() < (1 << 20)) {
+            out += line;
+        }
+
+        return out;
+    }();
+
+    return src;
+}
+
+as::bench::registrar runtime_ticks("fsm/runtime finite_state_machine", "ticks", [] {
+    static runtime_scanner fsm;
+    scan_input in;
+
+    for(char ch : scan_source()) {
+        in.ch = ch;
+        fsm.tick(in);
+    }
+
+    as::bench::keep(in);
+    return scan_source().size();
+});
+
+as::bench::registrar static_ticks("fsm/static_finite_state_machine", "ticks", [] {
+    static_scanner fsm(s::BASE);
+    scan_input in;
+
+    for(char ch : scan_source()) {
+        in.ch = ch;
+        fsm.tick(in);
+    }
+
+    as::bench::keep(in);
+    return scan_source().size();
+});
+
+as::bench::registrar static_run_bytes("fsm/static_finite_state_machine run, comments skipped", "bytes", [] {
+    static_skipping_scanner fsm(s::BASE);
+    scan_input in;
+
+    const char* begin = scan_source().data();
+    fsm.run(in, begin, begin + scan_source().size(), [](scan_input& in, const char* it) { in.ch = *it; });
+
+    as::bench::keep(in);
+    return scan_source().size();
+});
+
+}
@@ -0,0 +1,256 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#include <string>
+#include "bench.hpp"
+#include "lexer/lexer.hpp"
+#include "lexer/line_index.hpp"
+
+namespace {
+
+// a representative chunk of source, repeated to build large inputs
+const std::string sample_source =
+    "# generated test program\n"
+    ".text\n"
+    "main:\n"
+    "add $t0, $t1, $t2\n"
+    "addi $t0, $t0, 100\n"
+    "ori $8, $9, 2\n"
+    "lw $t1, 4($sp)\n"
+    "sub $s0, $s1, $s2 # subtract\n"
+    "j main\n"
+    ".data\n"
+    "msg: .asciiz \"hello world, this is a string literal\"\n";
+
+// mostly comments
+const std::string comment_source =
+    "# ------------------------------------------------------------------------------\n"
+    "# this routine was generated, the comments describe every step it takes in detail\n"
+    "add $t0, $t1, $t2 # add the two temporaries together and keep the result in t0\n";
+
+// mostly string data
+const std::string data_source =
+    "greeting: .asciiz \"The quick brown fox jumps over the lazy dog, again and again and again\"\n"
+    "farewell: .asciiz \"Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod\"\n";
+
+// mostly labels and mnemonics
+const std::string label_source =
+    "compute_checksum_loop: j compute_checksum_loop\n"
+    "jal handle_interrupt_vector\n"
+    "j compute_checksum_done\n";
+
+// mostly register operands and immediates
+const std::string register_source =
+    "add $t0, $t1, $t2\n"
+    "sub $s0, $s1, $31\n"
+    "addi $sp, $sp, -16\n"
+    "ori $8, $0, 0xFF\n"
+    "lw $ra, 12($sp)\n";
+
+// long comment and string lines, where scanning dominates over per line and per token costs
+const std::string long_line_source =
+    "# " + std::string(4000, '-') + "\n"
+    ".asciiz \"" + std::string(4000, 'x') + "\"\n";
+
+std::string make_source(const std::string& sample, std::size_t min_bytes) {
+    std::string src;
+    src.reserve(min_bytes + sample.size());
+
+    while(src.size() < min_bytes) {
+        src += sample;
+    }
+
+    return src;
+}
+
+const std::string& source_64kb() {
+    static const std::string src = make_source(sample_source, 64 << 10);
+    return src;
+}
+
+const std::string& source_16mb() {
+    static const std::string src = make_source(sample_source, 16 << 20);
+    return src;
+}
+
+const std::string& label_source_64kb() {
+    static const std::string src = make_source(label_source, 64 << 10);
+    return src;
+}
+
+const std::string& register_source_64kb() {
+    static const std::string src = make_source(register_source, 64 << 10);
+    return src;
+}
+
+const std::string& long_line_source_64kb() {
+    static const std::string src = make_source(long_line_source, 64 << 10);
+    return src;
+}
+
+const std::string& comment_source_64kb() {
+    static const std::string src = make_source(comment_source, 64 << 10);
+    return src;
+}
+
+const std::string& data_source_64kb() {
+    static const std::string src = make_source(data_source, 64 << 10);
+    return src;
+}
+
+as::bench::registrar lex_bytes("lexer/lex 64KB", "bytes", [] {
+    as::lexer lexer;
+    auto tokens = lexer.lex(source_64kb());
+    return tokens.has_value() ? source_64kb().size() : 0;
+});
+
+// the cost of profiling every tick, see lexer::lex with a profiler
+as::bench::registrar lex_profiled_bytes("lexer/lex 64KB profiled", "bytes", [] {
+    as::lexer lexer;
+    as::profiler profile;
+    as::diagnostic_list diagnostics;
+
+    auto tokens = lexer.lex(source_64kb(), profile, diagnostics);
+    return tokens.has_value() ? source_64kb().size() : 0;
+});
+
+as::bench::registrar lex_borrowed_bytes("lexer/lex borrowed 64KB", "bytes", [] {
+    as::lexer lexer;
+    auto tokens = lexer.lex(source_64kb(), as::attribute_storage::BORROWED);
+    return tokens.has_value() ? source_64kb().size() : 0;
+});
+
+as::bench::registrar lex_interned_bytes("lexer/lex interned 64KB", "bytes", [] {
+    as::interner symbols;
+    as::lexer lexer;
+    auto tokens = lexer.lex(source_64kb(), as::attribute_storage::OWNED, &symbols);
+    return tokens.has_value() ? source_64kb().size() : 0;
+});
+
+as::bench::registrar lex_label_bytes("lexer/lex labels 64KB", "bytes", [] {
+    as::lexer lexer;
+    auto tokens = lexer.lex(label_source_64kb());
+    return tokens.has_value() ? label_source_64kb().size() : 0;
+});
+
+as::bench::registrar lex_interned_label_bytes("lexer/lex interned labels 64KB", "bytes", [] {
+    as::interner symbols;
+    as::lexer lexer;
+    auto tokens = lexer.lex(label_source_64kb(), as::attribute_storage::OWNED, &symbols);
+    return tokens.has_value() ? label_source_64kb().size() : 0;
+});
+
+as::bench::registrar lex_register_bytes("lexer/lex registers 64KB", "bytes", [] {
+    as::lexer lexer;
+    auto tokens = lexer.lex(register_source_64kb());
+    return tokens.has_value() ? register_source_64kb().size() : 0;
+});
+
+as::bench::registrar lex_comment_bytes("lexer/lex comments 64KB", "bytes", [] {
+    as::lexer lexer;
+    auto tokens = lexer.lex(comment_source_64kb());
+    return tokens.has_value() ? comment_source_64kb().size() : 0;
+});
+
+as::bench::registrar lex_data_bytes("lexer/lex strings 64KB", "bytes", [] {
+    as::lexer lexer;
+    auto tokens = lexer.lex(data_source_64kb());
+    return tokens.has_value() ? data_source_64kb().size() : 0;
+});
+
+as::bench::registrar lex_long_line_bytes("lexer/lex long lines 64KB", "bytes", [] {
+    as::lexer lexer;
+    auto tokens = lexer.lex(long_line_source_64kb());
+    return tokens.has_value() ? long_line_source_64kb().size() : 0;
+});
+
+as::bench::registrar stream_bytes("lexer/stream 64KB in 4KB chunks", "bytes", [] {
+    std::size_t count = 0;
+    as::diagnostic_list diagnostics;
+    as::lexer::stream stream([&count](as::token&&) { ++count; }, diagnostics);
+
+    std::string_view src = source_64kb();
+
+    for(std::size_t pos = 0; pos < src.size(); pos += 4096) {
+        stream.feed(src.substr(pos, 4096));
+    }
+
+    as::bench::keep(count);
+    return stream.finish() ? src.size() : 0;
+});
+
+// one lexer shared by every call, each snippet is a single statement so per call cost dominates
+as::bench::registrar lex_snippets("lexer/lex snippets, shared lexer", "snippets", [] {
+    static const as::lexer lexer;
+    constexpr std::size_t snippets = 1000;
+
+    for(std::size_t i = 0; i < snippets; ++i) {
+        auto tokens = lexer.lex("addi $t0, $t1, 100\n");
+        as::bench::keep(tokens);
+    }
+
+    return snippets;
+});
+
+// one line in the middle of a 200k line source changes back and forth, only it is lexed again
+as::bench::registrar relex_line("lexer/relex 1 line of 200k", "edits", [] {
+    static const as::lexer lexer;
+    static std::string source = make_source("addi $t0, $t0, 100\n", 200000 * 19);
+    static as::token_stream tokens = lexer.lex(source).value();
+    static as::diagnostic_list diagnostics;
+
+    constexpr std::size_t line = 100000;
+    constexpr std::size_t edits = 100;
+
+    for(std::size_t i = 0; i < edits; ++i) {
+        source.replace(line * 19, 19, i % 2 ? "addi $t0, $t0, 100\n" : "addi $t1, $t1, 200\n");
+        lexer.relex(tokens, source, { line, 1, 1 }, diagnostics);
+    }
+
+    return edits;
+});
+
+as::bench::registrar lex_200k_lines("lexer/lex 200k lines", "edits", [] {
+    static const as::lexer lexer;
+    static const std::string source = make_source("addi $t0, $t0, 100\n", 200000 * 19);
+
+    auto tokens = lexer.lex(source);
+    return tokens.has_value() ? 1 : 0;
+});
+
+as::bench::registrar lex_parallel_bytes("lexer/lex parallel 16MB", "bytes", [] {
+    as::lexer lexer;
+    as::diagnostic_list diagnostics;
+    auto tokens = lexer.lex_parallel(source_16mb(), diagnostics);
+    return tokens.has_value() ? source_16mb().size() : 0;
+});
+
+as::bench::registrar lex_serial_bytes("lexer/lex 16MB", "bytes", [] {
+    as::lexer lexer;
+    auto tokens = lexer.lex(source_16mb());
+    return tokens.has_value() ? source_16mb().size() : 0;
+});
+
+// only one statement's tokens exist at a time, rather than all of them
+as::bench::registrar statements_bytes("lexer/statements 16MB", "bytes", [] {
+    as::lexer lexer;
+    as::diagnostic_list diagnostics;
+    std::size_t tokens = 0;
+
+    for(auto& statement : lexer.statements(source_16mb(), diagnostics)) {
+        tokens += statement.size();
+    }
+
+    as::bench::keep(tokens);
+    return source_16mb().size();
+});
+
+// building the index for a source and finding the line of an error near its end
+as::bench::registrar line_index_bytes("lexer/line index 16MB", "bytes", [] {
+    as::line_index lines(source_16mb());
+    as::bench::keep(lines.locate(static_cast<std::uint32_t>(source_16mb().size() - 1)).line);
+    return source_16mb().size();
+});
+
+}
@@ -0,0 +1,22 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#include <string>
+#include "bench.hpp"
+
+// usage: mips_asm_bench [filter]
+// runs every registered benchmark whose name contains filter
+int main(int argc, char* argv[]) {
+    std::string filter = argc > 1 ? argv[1] : "";
+
+    for(auto& bc : as::bench::registry()) {
+        if(bc.name.find(filter) == std::string::npos) {
+            continue;
+        }
+
+        as::bench::report(bc, as::bench::measure(bc));
+    }
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "bench.hpp"
+#include "spec/instruction_defs.hpp"
+
+namespace {
+
+// a mix of mnemonics, registers and labels as they come out of the lexer
+const std::vector<std::string_view>& lexemes() {
+    static const std::vector<std::string_view> words = {
+        "add", "t0", "addiu", "sp", "main", "lw", "ra", "loop_end", "sw", "zero", "j", "s7", "beq", "print_string"
+    };
+
+    return words;
+}
+
+// the mnemonic lookup as it was, a hash map keyed by std::string
+const std::unordered_map<std::string, std::uint8_t>& string_map() {
+    static const std::unordered_map<std::string, std::uint8_t> map = [] {
+        std::unordered_map<std::string, std::uint8_t> m;
+
+        for(std::uint8_t i = 0; i < as::spec::instructions::count(); ++i) {
+            m.emplace(std::string(as::spec::instructions::mnemonic(i)), i);
+        }
+
+        return m;
+    }();
+
+    return map;
+}
+
+constexpr std::size_t rounds = 100000;
+
+as::bench::registrar lookup_map("spec/mnemonic lookup unordered_map<std::string>", "lookups", [] {
+    std::size_t found = 0;
+
+    for(std::size_t r = 0; r < rounds; ++r) {
+        for(auto word : lexemes()) {
+            found += string_map().count(std::string(word));
+        }
+    }
+
+    as::bench::keep(found);
+    return rounds * lexemes().size();
+});
+
+as::bench::registrar lookup_hash("spec/mnemonic lookup perfect hash", "lookups", [] {
+    std::size_t found = 0;
+
+    for(std::size_t r = 0; r < rounds; ++r) {
+        for(auto word : lexemes()) {
+            found += as::spec::instructions::id(word).has_value();
+        }
+    }
+
+    as::bench::keep(found);
+    return rounds * lexemes().size();
+});
+
+}
@@ -8,19 +8,50 @@
 #include <vector>
 #include <sstream>
 #include <map>
+#include "../lexer/diagnostic_sink.hpp"
+#include "../lexer/generator.hpp"
 #include "../lexer/token.hpp"
+#include "../lexer/token_stream.hpp"
 #include "op_sequences.hpp"
 #include "../spec/instruction_defs.hpp"
 
 
 namespace as {
+
+/**
+ * Assemble tokens into a flat binary, the .text section followed by the .data section
+ * The binary is loaded at 0x4000f0, .data starts at the first word after .text
+ * Statements are assembled once, in order. Labels that are used before they're defined, or that are in .data,
+ * are written as 0 and patched once the end of the source is reached
+ * @param tokens
+ * @param sink   If set, errors and warnings are reported to it, with the offset of the token they're about
+ * @return The binary, or nullopt if there were errors
+ */
+std::optional<std::vector<std::uint8_t>>
+emit(const token_stream& tokens, diagnostic_sink* sink = nullptr);
+
 /**
- *
+ * Like emit(), but instructions are encoded concurrently
+ * Every statement is laid out first, so every label is placed, then the instructions are cut into chunks
+ * that are encoded at once, each straight into its words of the binary
  * @param tokens
- * @return
+ * With one thread, or too few instructions for more than one chunk, it is emit()
+ * @param threads Number of threads to encode with, 0 for one per hardware thread
+ * @param sink    As emit(), the diagnostics are reported once the binary is done, in the order they appear
+ * @return The binary, identical to what emit() returns whatever the number of threads, or nullopt if there were errors
+ */
+std::optional<std::vector<std::uint8_t>>
+emit_parallel(const token_stream& tokens, unsigned threads = 0, diagnostic_sink* sink = nullptr);
+
+/**
+ * Like emit(), but statements are pulled from the lexer one at a time, i.e. from lexer::statements(),
+ * so the tokens of the whole source never need to exist at once
+ * @param statements The statements, each ending with a NEW_LINE
+ * @param sink       As emit()
+ * @return As emit()
  */
 std::optional<std::vector<std::uint8_t>>
-emit(const std::vector<token>& tokens);
+emit(generator<token_stream> statements, diagnostic_sink* sink = nullptr);
 
 }
 
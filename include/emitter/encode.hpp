@@ -6,22 +6,123 @@
 #define MIPS_ASM_ENCODE_HPP
 
 #include <optional>
+#include <string_view>
 #include <vector>
+#include "lexer/diagnostic_sink.hpp"
 #include "lexer/token.hpp"
+#include "lexer/token_stream.hpp"
+#include "emitter/encoding_plan.hpp"
 #include "emitter/op_sequences.hpp"
 
 namespace as {
 
+// Why a branch to a label wasn't encoded
+inline constexpr std::string_view branch_out_of_range =
+    "Branch target out of range (-32768 <= x <= 32767 instructions from the branch)";
+
 /**
  * Encode an instruction using a token buffer, and a set of labels
  * @param tokens
  * @param labels
- * @return Optional encoded MIPs instruction if encoding worked
- *         Messages & errors are passed in the stringstream
+ * @param sink   If set, why an instruction couldn't be encoded, warnings and traces are reported to it
+ *               Nothing is formatted or allocated unless it wants a diagnostic
+ * @param pc     The address of the instruction, a branch to a label is encoded relative to it
+ * @return Optional encoded MIPs instruction if encoding worked,
+ *         a pseudo-instruction (e.g. lw $t0, label) isn't as it is more than one
  */
 std::optional<std::uint32_t>
 encode_instruction(const std::vector<token> &tokens,
-                   const std::unordered_map<std::string, std::uint32_t> &labels = {});
+                   const std::unordered_map<std::string, std::uint32_t> &labels = {},
+                   diagnostic_sink* sink = nullptr,
+                   std::uint32_t pc = 0);
+
+/**
+ * Encode an instruction whose symbols were interned while lexing, labels are looked up by symbol id
+ * @param tokens
+ * @param label_addresses The address of each label indexed by its symbol id, nullopt if a symbol isn't a label
+ * @param sink            As encode_instruction()
+ * @param pc              As encode_instruction()
+ * @return As encode_instruction()
+ */
+std::optional<std::uint32_t>
+encode_interned_instruction(const std::vector<token> &tokens,
+                            const std::vector<std::optional<std::uint32_t>> &label_addresses,
+                            diagnostic_sink* sink = nullptr,
+                            std::uint32_t pc = 0);
+
+/**
+ * Find the plan to encode the statement [begin, end) of a token stream with
+ * @param sink If set, why there isn't one is reported to it
+ * @return The plan, or nullptr if the statement isn't an instruction that can be encoded
+ */
+const encoding_plan* find_statement_plan(const token_stream& tokens, std::size_t begin, std::size_t end,
+                                        diagnostic_sink* sink = nullptr);
+
+/**
+ * Report an operand of the statement starting at begin whose value failed its field's range_check
+ */
+void report_out_of_range(const token_stream& tokens, std::size_t begin, const encoded_field& field,
+                         diagnostic_sink& sink);
+
+/**
+ * Trace the words the statement starting at begin was encoded as
+ */
+void trace_encoded(const token_stream& tokens, std::size_t begin, const encoded_words& words, diagnostic_sink& sink);
+
+/**
+ * Encode the statement [begin, end) of a token stream in place, as the emitter does
+ * It is a template so label_address is called directly, only the plan lookup and diagnostics are out of line
+ * @param pc            The address of its first word
+ * @param label_address std::optional<std::uint32_t>(std::size_t index), returns the address of the label token
+ *                      at an index of tokens, or nullopt if it isn't known yet
+ * @param unresolved    Set to the plan if the label's address wasn't known, its label fields are encoded as 0
+ *                      and the address can be ORed in later, see encoded_field. Otherwise set to nullptr
+ * @param sink          As encode_instruction()
+ * @return The words of the instruction if encoding worked, statement_words() of them
+ */
+template <typename LabelAddress>
+std::optional<encoded_words>
+encode_statement(const token_stream& tokens, std::size_t begin, std::size_t end, std::uint32_t pc,
+                 LabelAddress&& label_address, const encoding_plan*& unresolved, diagnostic_sink* sink = nullptr) {
+    auto plan = find_statement_plan(tokens, begin, end, sink);
+
+    if(plan == nullptr) {
+        return std::nullopt;
+    }
+
+    bool label_defined = true;
+
+    auto ins = plan->encode(pc,
+        [&tokens, begin](std::size_t i) { return tokens.number(begin + i); },
+        [&label_address, &label_defined, begin](std::size_t i) {
+            auto address = label_address(begin + i);
+            label_defined = address.has_value();
+            return address;
+        },
+        [&tokens, begin, sink](const encoded_field& field) {
+            if(sink != nullptr) {
+                report_out_of_range(tokens, begin, field, *sink);
+            }
+        });
+
+    if(!ins.has_value()) {
+        return std::nullopt;
+    }
+
+    unresolved = label_defined ? nullptr : plan;
+
+    if(trace_enabled && sink != nullptr) {
+        trace_encoded(tokens, begin, ins.value(), *sink);
+    }
+
+    return ins;
+}
+
+/**
+ * @return How many words the statement [begin, end) of a token stream is encoded as, without encoding it.
+ *         1 unless it's a pseudo-instruction, or if it doesn't encode
+ */
+std::size_t statement_words(const token_stream& tokens, std::size_t begin, std::size_t end);
 
 }
 
@@ -0,0 +1,226 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#ifndef MIPS_ASM_ENCODING_PLAN_HPP
+#define MIPS_ASM_ENCODING_PLAN_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include "op_sequences.hpp"
+#include "../spec/instruction_defs.hpp"
+
+namespace as {
+
+/**
+ * Where the value of an encoded field comes from
+ */
+enum class field_source : std::uint8_t {
+    NUMBER,         // the number attribute of the operand's token
+    LABEL,          // the address of the label the operand's token names, 0 if it isn't defined
+    LABEL_RELATIVE, // the distance to the label from the word after the field's, as a branch counts it
+    LABEL_HIGH      // the upper half of the label's address, rounded for the lower half being sign extended
+};
+
+/**
+ * What happens when a field's value doesn't fit its mask
+ */
+enum class range_check : std::uint8_t {
+    NONE,    // the value is masked
+    WARNING, // the value is masked, it's worth telling the user about
+    ERROR    // the instruction can't be encoded
+};
+
+/**
+ * An operand of a statement, and where its bits go in the encoded instruction
+ * i.e. instruction |= ((value >> align) & mask) << shift
+ */
+struct encoded_field {
+    std::uint8_t    token;  // the operand's index in the statement
+    field_source    source;
+    range_check     check;  // values outside [0, mask] fail this check, or outside its signed range if relative
+    std::uint8_t    align;  // low bits dropped from the value, e.g. a jump target is word aligned
+    std::uint8_t    shift;
+    std::uint8_t    word;   // which word of the instruction it's in, a pseudo-instruction has more than one
+    std::uint32_t   mask;
+
+    // a value down to -(mask + 1) / 2 passes the range_check too, an immediate can be written signed or unsigned
+    bool            either_sign = false;
+
+    bool is_label() const {
+        return source != field_source::NUMBER;
+    }
+
+    /**
+     * The value of a label field
+     * @param address   The label's address
+     * @param pc        The address of the field's word
+     */
+    std::int64_t label_value(std::uint32_t address, std::uint32_t pc) const {
+        switch(source) {
+            case field_source::LABEL_RELATIVE:
+                return static_cast<std::int64_t>(address) - (static_cast<std::int64_t>(pc) + 4);
+
+            // the lower half is added as a signed offset, so when it's negative the upper half is one more
+            case field_source::LABEL_HIGH:
+                return static_cast<std::int64_t>(address) + 0x8000;
+
+            default:
+                return address;
+        }
+    }
+
+    /**
+     * @return If a value passes this field's range_check
+     */
+    bool fits(std::int64_t value) const {
+        if(source == field_source::LABEL_RELATIVE) {
+            auto signed_max = static_cast<std::int64_t>(mask >> 1);
+            auto aligned = value >> align;
+
+            return (value & ((std::int64_t(1) << align) - 1)) == 0 && aligned >= -signed_max - 1 && aligned <= signed_max;
+        }
+
+        auto min = either_sign ? -static_cast<std::int64_t>(mask >> 1) - 1 : 0;
+        return value >= min && value <= mask;
+    }
+
+    /**
+     * @return The bits of a value in the word, i.e. ((value >> align) & mask) << shift
+     */
+    std::uint32_t bits(std::int64_t value) const {
+        return ((static_cast<std::uint32_t>(value) >> align) & mask) << shift;
+    }
+};
+
+/**
+ * The words a statement is encoded as, a pseudo-instruction (e.g. lw $t0, label) assembles to more than one
+ */
+struct encoded_words {
+    static constexpr std::size_t max_size = 2;
+
+    std::array<std::uint32_t, max_size> words = { };
+    std::size_t size = 0;
+
+    const std::uint32_t* begin() const {
+        return words.data();
+    }
+
+    const std::uint32_t* end() const {
+        return words.data() + size;
+    }
+};
+
+/**
+ * How to encode a statement of an op_sequence as an instruction,
+ * a plan exists for each instruction and sequence that supports its operand format
+ * Plans are compiled once from the instruction definitions and op_sequences,
+ * so encoding a statement doesn't look up any operand by name
+ */
+class encoding_plan {
+public:
+    // no instruction format has more operand fields, see R
+    static constexpr std::size_t max_fields = 4;
+
+    // $at, the register pseudo-instructions are assembled with
+    static constexpr std::uint32_t assembler_temporary = 1;
+
+    encoding_plan() = default;
+
+    /**
+     * Find the plan to encode an instruction with a sequence of operands
+     * @param instruction   The instruction's id, see spec::instructions::id
+     * @param sequence      The sequence the statement matched, from op_sequences
+     * @return The plan, or nullptr if the sequence doesn't support the instruction's operand format
+     */
+    static const encoding_plan* find(std::uint8_t instruction, const op_sequence& sequence);
+
+    /**
+     * @param word  Which word of the instruction
+     * @return The upper and lower fields of the instruction, the operands are ORed in to this
+     */
+    std::uint32_t base(std::size_t word = 0) const {
+        return m_base.words[word];
+    }
+
+    /**
+     * @return How many words the instruction is, more than one if it's a pseudo-instruction
+     */
+    std::size_t words() const {
+        return m_base.size;
+    }
+
+    const encoded_field* begin() const {
+        return m_fields.data();
+    }
+
+    const encoded_field* end() const {
+        return m_fields.data() + m_size;
+    }
+
+    /**
+     * Encode a statement
+     * @param pc            The address of the instruction's first word, branches are relative to it
+     * @param number        Returns the number attribute of the token at an index of the statement
+     * @param label         Returns the address of the label named by the token at an index, or nullopt.
+     *                      A label field whose address isn't known is encoded as 0, and isn't range checked
+     * @param out_of_range  Called with each field whose value failed its range_check
+     * @return The instruction, or nullopt if an operand failed a range_check::ERROR
+     */
+    template <typename Number, typename Label, typename OutOfRange>
+    std::optional<encoded_words> encode(std::uint32_t pc, Number&& number, Label&& label,
+                                        OutOfRange&& out_of_range) const {
+        encoded_words instruction = m_base;
+
+        for(auto& field : *this) {
+            std::int64_t value = 0;
+
+            if(field.source == field_source::NUMBER) {
+                value = number(field.token);
+            }
+            else {
+                auto address = label(field.token);
+
+                if(!address.has_value()) {
+                    continue;
+                }
+
+                value = field.label_value(address.value(), pc + 4 * field.word);
+            }
+
+            if(field.check != range_check::NONE && !field.fits(value)) {
+                out_of_range(field);
+
+                if(field.check == range_check::ERROR) {
+                    return std::nullopt;
+                }
+            }
+
+            instruction.words[field.word] |= field.bits(value);
+        }
+
+        return instruction;
+    }
+
+    template <typename Number, typename Label>
+    std::optional<encoded_words> encode(std::uint32_t pc, Number&& number, Label&& label) const {
+        return encode(pc, number, label, [](const encoded_field&) { });
+    }
+
+private:
+    /**
+     * Compile the plan for an instruction from the operand positions of a sequence
+     * @return The plan, or nullopt if the sequence doesn't support the instruction's operand format
+     */
+    static std::optional<encoding_plan> compile(const spec::instruction_def& def, const op_sequence& sequence);
+
+    encoded_words m_base;
+    std::array<encoded_field, max_fields> m_fields = { };
+    std::size_t m_size = 0;
+};
+
+}
+
+#endif //MIPS_ASM_ENCODING_PLAN_HPP
@@ -5,6 +5,9 @@
 #ifndef MIPS_ASM_TOKEN_OPERANDS_MAP_HPP
 #define MIPS_ASM_TOKEN_OPERANDS_MAP_HPP
 
+#include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <optional>
 #include <vector>
 #include <map>
@@ -16,6 +19,66 @@ namespace as {
 
     using namespace spec;
 
+/**
+ * The token types of a statement packed into an integer, 4 bits per type,
+ * so a statement is matched against an operation sequence with one compare
+ * No token type is 0, so sequences of different lengths never pack to the same signature
+ */
+class op_signature {
+public:
+    // the most token types a signature holds, no operation sequence is longer
+    static constexpr std::size_t max_types = 15;
+
+    static_assert(static_cast<std::size_t>(token_type::TOKEN_TYPE_END) <= 16, "token types must fit in 4 bits");
+
+    constexpr op_signature() = default;
+
+    /**
+     * Pack a sequence of token types
+     */
+    template <typename TokenTypes>
+    static constexpr op_signature of(const TokenTypes& types) {
+        op_signature signature;
+
+        for(auto type : types) {
+            signature.push(type);
+        }
+
+        return signature;
+    }
+
+    /**
+     * Add the next token type, a signature with more than max_types matches no sequence
+     */
+    constexpr void push(token_type type) {
+        if(m_size++ >= max_types) {
+            m_value = overflowed;
+            return;
+        }
+
+        m_value = (m_value << 4) | static_cast<std::uint64_t>(type);
+    }
+
+    constexpr std::uint64_t value() const {
+        return m_value;
+    }
+
+    constexpr bool operator==(const op_signature& other) const {
+        return m_value == other.m_value;
+    }
+
+    constexpr bool operator<(const op_signature& other) const {
+        return m_value < other.m_value;
+    }
+
+private:
+    // the top 4 bits of a signature are never set, so this can't be one
+    static constexpr std::uint64_t overflowed = std::numeric_limits<std::uint64_t>::max();
+
+    std::uint64_t m_value = 0;
+    std::size_t m_size = 0;
+};
+
 /**
  * An operation sequence stores a sequence of token types
  * that represent a operation
@@ -59,6 +122,13 @@ public:
      */
     const std::vector<token_type>& token_types() const;
 
+    /**
+     * @return The token types, packed
+     */
+    const op_signature& signature() const {
+        return m_signature;
+    }
+
     bool supports_operand_format(const spec::operand_def_format& fmt) const;
 
     /**
@@ -73,6 +143,7 @@ public:
 
 private:
     std::vector<token_type> m_token_types;
+    op_signature m_signature;
     operand_locations m_operand_locations = { };
 };
 
@@ -88,6 +159,14 @@ public:
     static const std::vector<op_sequence>& all() {
         return sequences;
     }
+
+    /**
+     * Find the sequence a statement matches, the sequences are indexed by signature so this is a binary search
+     * @param signature The statement's token types, see op_signature
+     * @return The sequence, or nullptr if the statement matches none
+     */
+    static const op_sequence* find(const op_signature& signature);
+
 private:
     static const std::vector<op_sequence> sequences;
 };
@@ -0,0 +1,116 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#ifndef MIPS_ASM_DENSE_TRANSITION_TABLE_HPP
+#define MIPS_ASM_DENSE_TRANSITION_TABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+#include "transition.hpp"
+
+namespace as {
+
+/**
+ * A transition table indexed directly by the value of the state
+ *
+ * All transitions are stored contiguously, grouped by their initial state (in the order they were added),
+ * looking up the transitions for a state is a single index into a vector of ranges
+ *
+ * @tparam States An enum whose values are small, non-negative integers
+ */
+template <typename States, typename InputsType>
+class dense_transition_table {
+public:
+    dense_transition_table() = default;
+
+    /**
+     * Add a transition to the transition table
+     * @param transition
+     */
+    void add_transition(const transition<States, InputsType>& transition) {
+        auto state = index(transition.get_initial_state());
+
+        // states we haven't seen yet have no transitions, which begin (and end) after all existing ones
+        if(state >= m_ranges.size()) {
+            auto size = static_cast<std::uint32_t>(m_transitions.size());
+            m_ranges.resize(state + 1, range{ size, size });
+        }
+
+        // insert after the last transition of this state, preserving the order they were added in
+        auto position = m_ranges.at(state).end;
+        m_transitions.insert(m_transitions.begin() + position, transition);
+
+        // every state stored after this one has shifted up by one
+        m_ranges.at(state).end++;
+
+        for(auto i = state + 1; i < m_ranges.size(); ++i) {
+            m_ranges.at(i).begin++;
+            m_ranges.at(i).end++;
+        }
+    }
+
+    /**
+     * Test a state for transition against an input value
+     * @param state The state
+     * @param inputs The input type
+     * @return The first transition whose condition matches, or nullptr if there is none
+     */
+    const transition<States, InputsType>*
+    test_for_transitions(const States& state, InputsType& inputs) const {
+        auto i = static_cast<std::size_t>(state);
+
+        if(i >= m_ranges.size()) {
+            return nullptr;
+        }
+
+        const auto* it  = m_transitions.data() + m_ranges[i].begin;
+        const auto* end = m_transitions.data() + m_ranges[i].end;
+
+        for(; it != end; ++it) {
+            if(it->test_transition_condition(inputs)) {
+                return it;
+            }
+        }
+
+        return nullptr;
+    }
+
+private:
+    /**
+     * [begin, end) indices into m_transitions for a state
+     */
+    struct range {
+        std::uint32_t begin;
+        std::uint32_t end;
+    };
+
+    static std::size_t index(const States& state) {
+        auto value = static_cast<std::underlying_type_t<States>>(state);
+
+        if constexpr(std::is_signed_v<decltype(value)>) {
+            if(value < 0) {
+                throw std::invalid_argument("dense_transition_table requires non-negative state values");
+            }
+        }
+
+        return static_cast<std::size_t>(value);
+    }
+
+    /**
+     * Indexed by state value, gives the transitions that state can undergo
+     */
+    std::vector<range> m_ranges;
+
+    /**
+     * Every transition, grouped by initial state
+     */
+    std::vector<::as::transition<States, InputsType>> m_transitions;
+};
+
+}
+
+#endif //MIPS_ASM_DENSE_TRANSITION_TABLE_HPP
@@ -7,7 +7,12 @@
 
 #include <iostream>
 #include <functional>
+#include <vector>
+#include <type_traits>
+#include "profiler.hpp"
+#include "skip.hpp"
 #include "transition_table.hpp"
+#include "dense_transition_table.hpp"
 
 using namespace std::placeholders;
 
@@ -22,27 +27,58 @@ namespace as {
  *                      When you define transitions, you will be passed this input, and then you make the
  *                      decision to change state based on the passed input
  *                      (i.e. these trigger the state to change from one to the next)
+ * @tparam Table        The transition table, dense_transition_table indexes transitions by state value,
+ *                      use transition_table for states with sparse or negative values
+ * @tparam Profiler     The profiling policy, no_profiling records nothing, profiler records ticks, transitions
+ *                      and time per state but needs small non-negative state values
  */
-template <typename States, typename InputsType>
+template <typename States, typename InputsType,
+          template <typename, typename> class Table = dense_transition_table,
+          typename Profiler = no_profiling>
 class finite_state_machine {
 public:
-    explicit finite_state_machine(States start_state) :
-        m_current_state(start_state),
+    explicit finite_state_machine(States start_state, Profiler profile = Profiler()) :
         m_on_no_transition_available(
-            std::bind(&finite_state_machine<States,InputsType>::on_no_transition_available, this, _1))
+            std::bind(&finite_state_machine::on_no_transition_available, this, _1)),
+        m_current_state(start_state),
+        m_profile(std::move(profile))
     {
 
     }
 
     virtual ~finite_state_machine() = default;
 
+    // the default no transition handler, and the callbacks counting fires for the profiler, point back at the machine
+    finite_state_machine(const finite_state_machine&) = delete;
+    finite_state_machine& operator=(const finite_state_machine&) = delete;
+
+    finite_state_machine(finite_state_machine&&) = delete;
+    finite_state_machine& operator=(finite_state_machine&&) = delete;
+
     /**
      * Add a transition to the transition table
      * @param transition
      * @see transition
      */
     void add_transition(const transition<States,InputsType>& transition) {
-        m_transition_table.add_transition(transition);
+        m_profile.add_transition(static_cast<std::size_t>(transition.get_initial_state()),
+                                 static_cast<std::size_t>(transition.get_transition_state()));
+
+        if constexpr(std::is_same_v<Profiler, no_profiling>) {
+            m_transition_table.add_transition(transition);
+        } else {
+            // the table hands back the transition that fired but not its number, so the callback reports it
+            auto number = m_transition_count++;
+
+            m_transition_table.add_transition({
+                transition.get_initial_state(), transition.get_transition_state(),
+                [transition](InputsType& in) { return transition.test_transition_condition(in); },
+                [transition, number, this](InputsType& in) {
+                    transition.run_transition_callback(in);
+                    m_profile.fired(number);
+                }
+            });
+        }
     }
 
 
@@ -67,6 +103,28 @@ public:
         }
     }
 
+    /**
+     * A function returning the first byte in [begin, end) a skipping state should be ticked with, or end,
+     * see skip.hpp
+     */
+    using skip_scan_func = std::function<const char*(const char*, const char*)>;
+
+    /**
+     * A callback for the span of bytes a state skipped
+     */
+    using skip_callback_func = std::function<void(InputsType&, const char*, const char*)>;
+
+    /**
+     * Let a state pass over runs of input at once when the machine is run(), rather than ticking for each byte
+     * It is for states that loop on themselves until a terminator, i.e. a comment that lasts until a newline
+     * @param state    The state that skips
+     * @param scan     Finds the end of the run
+     * @param callback Called with each span that was skipped, if set
+     */
+    void add_skip(const States& state, skip_scan_func scan, skip_callback_func callback = nullptr) {
+        m_skips.push_back({ state, std::move(scan), std::move(callback) });
+    }
+
     /**
      * Get the current state of the machine
      * @return state
@@ -75,32 +133,101 @@ public:
         return m_current_state;
     }
 
+    /**
+     * Move the machine to a state without a transition, i.e. to recover from an error
+     */
+    void set_state(States state) {
+        m_current_state = state;
+    }
+
+    /**
+     * @return What the profiling policy recorded
+     */
+    const Profiler& profile() const {
+        return m_profile;
+    }
+
+    Profiler& profile() {
+        return m_profile;
+    }
+
     /**
      * Run the FSM for one input iteration,
      * @return The current state
      */
     States tick(InputsType& input) {
+        const auto from = static_cast<std::size_t>(m_current_state);
+        m_profile.start_tick(from);
+
         auto transition = m_transition_table.test_for_transitions(m_current_state, input);
 
         // if a transition occurred
-        if(transition.has_value()) {
+        if(transition != nullptr) {
 
             // we need to run the callback, to run user-supplied state transition code
-            auto callback = transition.value().get_transition_callback();
-            callback(input);
+            transition->run_transition_callback(input);
 
             // update our state
-            m_current_state = transition.value().get_transition_state();
+            m_current_state = transition->get_transition_state();
         } else {
             // if no transition available,
             // ask our no transition available func what to do
             // (this just stays in the current state by default)
             m_current_state = m_on_no_transition_available(input);
+            m_profile.no_transition(from);
         }
 
+        m_profile.stop(from);
         return m_current_state;
     }
 
+    /**
+     * Run the FSM over a span of bytes, ticking once per byte
+     * Before each tick, if the state skips (see add_skip) the bytes it skips are passed over without ticking,
+     * so a span can start or end in the middle of a run
+     * @param feed void(InputsType&, const char* it), sets the input up for the byte at it before it is ticked
+     * @return The current state
+     */
+    template <typename Feed>
+    States run(InputsType& input, const char* begin, const char* end, Feed&& feed) {
+        for(const char* it = skip(input, begin, end); it != end; ) {
+            feed(input, it);
+            tick(input);
+
+            it = skip(input, it + 1, end);
+        }
+
+        return m_current_state;
+    }
+
+    /**
+     * Pass over the bytes the current state skips, if it does
+     * @return The next byte to tick
+     */
+    const char* skip(InputsType& input, const char* it, const char* end) {
+        for(auto& skip : m_skips) {
+            if(skip.state != m_current_state) {
+                continue;
+            }
+
+            const auto state = static_cast<std::size_t>(m_current_state);
+            m_profile.start_skip(state);
+
+            const char* stop = skip.scan(it, end);
+
+            if(stop != it && skip.callback) {
+                skip.callback(input, it, stop);
+            }
+
+            m_profile.skipped(state, stop - it);
+            m_profile.stop(state);
+
+            return stop;
+        }
+
+        return it;
+    }
+
 private:
     // if no transition is possible, just deadlock in current state
     States on_no_transition_available(const InputsType&) {
@@ -112,7 +239,21 @@ private:
     no_transition_available_func m_on_no_transition_available;
 
     States m_current_state;
-    transition_table<States,InputsType> m_transition_table;
+    Table<States,InputsType> m_transition_table;
+
+    struct skip_rule {
+        States state;
+        skip_scan_func scan;
+        skip_callback_func callback;
+    };
+
+    // usually only a few states skip, so they are searched in order
+    std::vector<skip_rule> m_skips;
+
+    Profiler m_profile;
+
+    // transitions added so far, each is numbered for the profiler
+    std::size_t m_transition_count = 0;
 
 };
 
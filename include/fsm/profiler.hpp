@@ -0,0 +1,193 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#ifndef MIPS_ASM_PROFILER_HPP
+#define MIPS_ASM_PROFILER_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace as {
+
+/**
+ * The profiling policy state machines use by default, it records nothing and every hook compiles away
+ * A policy is given the value of each state, see profiler for what each hook means
+ */
+struct no_profiling {
+    constexpr void add_transition(std::size_t, std::size_t) { }
+    void start_tick(std::size_t) { }
+    void fired(std::size_t) { }
+    void no_transition(std::size_t) { }
+    void start_skip(std::size_t) { }
+    void skipped(std::size_t, std::size_t) { }
+    void stop(std::size_t) { }
+};
+
+/**
+ * A profiling policy that records where a state machine spends its time:
+ * ticks, fallbacks when no transition was available and time per state, fire counts per transition,
+ * and how much input states skipped when the machine was run()
+ *
+ * The machine describes its transitions with add_transition, then counts each one by its number,
+ * so transitions between the same two states are counted apart
+ * State values must be small and non-negative
+ *
+ *  profiled_static_finite_state_machine<states, input, ...> machine(states::BASE);
+ *  machine.run(...);
+ *  machine.profile().write_dot(std::cout);
+ */
+class profiler {
+public:
+    struct state_stats {
+        std::uint64_t ticks = 0;
+
+        // ticks where no transition was available, so the machine stayed in the state
+        std::uint64_t no_transitions = 0;
+
+        // runs of input skipped in the state, and the bytes in them
+        std::uint64_t skips = 0;
+        std::uint64_t skipped_bytes = 0;
+
+        // time spent ticking and skipping in the state
+        std::chrono::nanoseconds time { 0 };
+    };
+
+    struct transition_stats {
+        std::size_t from;
+        std::size_t to;
+        std::uint64_t fired;
+    };
+
+    profiler() = default;
+
+    /**
+     * @param state_names Name of each state, indexed by state value, used by the reports
+     */
+    explicit profiler(std::vector<std::string> state_names) :
+        m_state_names(std::move(state_names))
+    {
+
+    }
+
+    /**
+     * The machine has a transition between two states, transitions are numbered in the order they are added
+     */
+    void add_transition(std::size_t from, std::size_t to) {
+        m_transitions.push_back({ from, to, 0 });
+    }
+
+    /**
+     * A tick started in a state
+     */
+    void start_tick(std::size_t state) {
+        stats(state).ticks++;
+        m_started = clock::now();
+    }
+
+    /**
+     * The transition with a number fired during the tick
+     */
+    void fired(std::size_t transition) {
+        m_transitions[transition].fired++;
+    }
+
+    /**
+     * No transition was available during the tick
+     */
+    void no_transition(std::size_t state) {
+        stats(state).no_transitions++;
+    }
+
+    /**
+     * The machine started skipping input in a state
+     */
+    void start_skip(std::size_t state) {
+        stats(state);
+        m_started = clock::now();
+    }
+
+    /**
+     * The state skipped bytes of input at once
+     */
+    void skipped(std::size_t state, std::size_t bytes) {
+        auto& s = stats(state);
+        s.skips++;
+        s.skipped_bytes += bytes;
+    }
+
+    /**
+     * The tick or skip that started in a state finished
+     */
+    void stop(std::size_t state) {
+        m_states[state].time += clock::now() - m_started;
+    }
+
+    /**
+     * @return Stats per state, indexed by state value
+     */
+    const std::vector<state_stats>& states() const {
+        return m_states;
+    }
+
+    /**
+     * @return Every transition of the machine, indexed by number, including those that never fired
+     */
+    const std::vector<transition_stats>& transitions() const {
+        return m_transitions;
+    }
+
+    /**
+     * @return The name of a state, or its value if it has none
+     */
+    std::string state_name(std::size_t state) const;
+
+    /**
+     * Forget everything recorded, keeping the state names and the transitions
+     */
+    void reset();
+
+    /**
+     * Write the stats as a table
+     */
+    void write_text(std::ostream& out) const;
+
+    /**
+     * Write the stats as a JSON object, { "states": [ ... ], "transitions": [ ... ] }
+     */
+    void write_json(std::ostream& out) const;
+
+    /**
+     * Write the transition graph in Graphviz dot, states are annotated with their ticks and time
+     * and transitions with how often they fired, transitions that never fired are dashed
+     */
+    void write_dot(std::ostream& out) const;
+
+private:
+    using clock = std::chrono::steady_clock;
+
+    state_stats& stats(std::size_t state) {
+        if(state >= m_states.size()) {
+            m_states.resize(state + 1);
+        }
+
+        return m_states[state];
+    }
+
+    std::vector<std::string> m_state_names;
+
+    std::vector<state_stats> m_states;
+
+    // the machine's transitions and their fire counts, indexed by number
+    std::vector<transition_stats> m_transitions;
+
+    clock::time_point m_started;
+};
+
+}
+
+#endif //MIPS_ASM_PROFILER_HPP
@@ -0,0 +1,58 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#ifndef MIPS_ASM_SKIP_HPP
+#define MIPS_ASM_SKIP_HPP
+
+#include <cstring>
+
+namespace as {
+
+/**
+ * Scanners for states that skip over runs of input, see static_skip and finite_state_machine::add_skip
+ * Each returns the first byte in [begin, end) the state should be ticked with, or end
+ */
+
+/**
+ * Skip to the first of a set of terminating bytes, a single terminator is found with memchr
+ *
+ *  static_skip<states::COMMENT, &skip_to<'\n'>>
+ */
+template <char... Terminators>
+const char* skip_to(const char* begin, const char* end) {
+    static_assert(sizeof...(Terminators) > 0, "skip_to needs a terminator");
+
+    if constexpr(sizeof...(Terminators) == 1) {
+        constexpr char terminator = (Terminators, ...);
+
+        auto found = std::memchr(begin, static_cast<unsigned char>(terminator), end - begin);
+        return found != nullptr ? static_cast<const char*>(found) : end;
+    } else {
+        for(const char* it = begin; it != end; ++it) {
+            if(((*it == Terminators) || ...)) {
+                return it;
+            }
+        }
+
+        return end;
+    }
+}
+
+/**
+ * Skip while a predicate, bool(char), holds
+ */
+template <auto Predicate>
+const char* skip_while(const char* begin, const char* end) {
+    const char* it = begin;
+
+    while(it != end && Predicate(*it)) {
+        ++it;
+    }
+
+    return it;
+}
+
+}
+
+#endif //MIPS_ASM_SKIP_HPP
@@ -0,0 +1,304 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#ifndef MIPS_ASM_STATIC_FINITE_STATE_MACHINE_HPP
+#define MIPS_ASM_STATIC_FINITE_STATE_MACHINE_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include "profiler.hpp"
+#include "skip.hpp"
+
+namespace as {
+
+/**
+ * A transition that is known at compile time
+ *
+ * @tparam LeavingState     The state we can leave
+ * @tparam EnteringState    The state we will enter
+ * @tparam ShouldTransition A function pointer, bool(InputsType&), that returns true if we should transition
+ * @tparam Callback         A function pointer, void(InputsType&), called when the transition occurs
+ *                          or nullptr if nothing should be called
+ */
+template <auto LeavingState, auto EnteringState, auto ShouldTransition, auto Callback = nullptr>
+struct static_transition {
+    static constexpr auto initial_state    = LeavingState;
+    static constexpr auto transition_state = EnteringState;
+    static constexpr bool skips            = false;
+
+    /**
+     * Tests if the input passed will trigger the transition
+     */
+    template <typename InputsType>
+    static bool test_transition_condition(InputsType& inputs) {
+        return ShouldTransition(inputs);
+    }
+
+    /**
+     * Run the transition callback, if there is one
+     */
+    template <typename InputsType>
+    static void run_transition_callback(InputsType& inputs) {
+        if constexpr(!std::is_same_v<decltype(Callback), std::nullptr_t>) {
+            Callback(inputs);
+        }
+    }
+};
+
+/**
+ * A run of input a state passes over at once when the machine is run(), rather than ticking for each byte
+ * It is for states that loop on themselves until a terminator, i.e. a comment that lasts until a newline
+ *
+ * @tparam State    The state that skips
+ * @tparam Scan     A function pointer, const char*(const char* begin, const char* end), returning the first
+ *                  byte the state should be ticked with or end, see skip.hpp
+ * @tparam Callback A function pointer, void(InputsType&, const char* begin, const char* end),
+ *                  called with each span that was skipped, or nullptr if nothing should be called
+ */
+template <auto State, auto Scan, auto Callback = nullptr>
+struct static_skip {
+    static constexpr auto initial_state = State;
+    static constexpr bool skips         = true;
+
+    /**
+     * Skip from begin
+     * @return The next byte to tick
+     */
+    template <typename InputsType>
+    static const char* skip(InputsType& inputs, const char* begin, const char* end) {
+        const char* stop = Scan(begin, end);
+
+        if constexpr(!std::is_same_v<decltype(Callback), std::nullptr_t>) {
+            if(stop != begin) {
+                Callback(inputs, begin, stop);
+            }
+        }
+
+        return stop;
+    }
+};
+
+/**
+ * A finite state machine whose transitions are all known at compile time
+ *
+ * Unlike finite_state_machine nothing is stored besides the current state (and the profiler, if it is profiled),
+ * tick() dispatches on the current state through a table with a handler per state, generated from the transitions,
+ * so finding the state's transitions is one indirect call however many states there are.
+ * The handler tests that state's transitions in the order they were declared,
+ * every predicate and callback in it is a direct call that can be inlined
+ *
+ * If no transition is available the machine stays in its current state
+ *
+ * @tparam States       An enum of possible states, with small non-negative values
+ * @tparam InputsType   The input that is passed to the machine when processing transitions
+ * @tparam Profiler     The profiling policy, no_profiling records nothing and takes no space,
+ *                      see profiled_static_finite_state_machine
+ * @tparam Transitions  A list of static_transition, and static_skip for states that skip runs of input
+ */
+template <typename States, typename InputsType, typename Profiler, typename... Transitions>
+class basic_static_finite_state_machine {
+public:
+    explicit constexpr basic_static_finite_state_machine(States start_state, Profiler profile = Profiler()) :
+        m_current_state(start_state),
+        m_profile(std::move(profile))
+    {
+        (describe<Transitions>(), ...);
+    }
+
+    /**
+     * Get the current state of the machine
+     * @return state
+     */
+    States get_state() const {
+        return m_current_state;
+    }
+
+    /**
+     * Move the machine to a state without a transition, i.e. to recover from an error
+     */
+    void set_state(States state) {
+        m_current_state = state;
+    }
+
+    /**
+     * @return What the profiling policy recorded
+     */
+    const Profiler& profile() const {
+        return m_profile;
+    }
+
+    Profiler& profile() {
+        return m_profile;
+    }
+
+    /**
+     * Run the FSM for one input iteration,
+     * @return The current state
+     */
+    States tick(InputsType& input) {
+        const auto from = index(m_current_state);
+        m_profile.start_tick(from);
+
+        if(!dispatch(input)) {
+            m_profile.no_transition(from);
+        }
+
+        m_profile.stop(from);
+        return m_current_state;
+    }
+
+    /**
+     * Run the FSM over a span of bytes, ticking once per byte
+     * Before each tick, if the state has a static_skip the bytes it skips are passed over without ticking,
+     * so a span can start or end in the middle of a run
+     * @param feed    void(InputsType&, const char* it), sets the input up for the byte at it before it is ticked
+     * @param resolve States(InputsType&, States state), called after each tick with the new state,
+     *                returns the state to carry on from, i.e. to recover after a callback found an error
+     * @return The current state
+     */
+    template <typename Feed, typename Resolve>
+    States run(InputsType& input, const char* begin, const char* end, Feed&& feed, Resolve&& resolve) {
+        for(const char* it = skip(input, begin, end); it != end; ) {
+            feed(input, it);
+            tick(input);
+
+            m_current_state = resolve(input, m_current_state);
+            it = skip(input, it + 1, end);
+        }
+
+        return m_current_state;
+    }
+
+    template <typename Feed>
+    States run(InputsType& input, const char* begin, const char* end, Feed&& feed) {
+        return run(input, begin, end, std::forward<Feed>(feed), [](InputsType&, States state) { return state; });
+    }
+
+    /**
+     * Pass over the bytes the current state skips, if it has a static_skip
+     * @return The next byte to tick
+     */
+    const char* skip(InputsType& input, const char* it, const char* end) {
+        (try_skip<Transitions>(input, it, end) || ...);
+        return it;
+    }
+
+private:
+    static constexpr std::size_t index(States state) {
+        return static_cast<std::size_t>(state);
+    }
+
+    static constexpr std::size_t state_count =
+        std::max({ std::size_t(0), (static_cast<std::size_t>(Transitions::initial_state) + 1)... });
+
+    using state_handler = bool (basic_static_finite_state_machine::*)(InputsType&);
+
+    // tick_state for each state, indexed by the state
+    template <std::size_t... State>
+    static constexpr std::array<state_handler, state_count> make_handlers(std::index_sequence<State...>) {
+        return { &basic_static_finite_state_machine::tick_state<State>... };
+    }
+
+    static constexpr std::array<state_handler, state_count> handlers =
+        make_handlers(std::make_index_sequence<state_count>{});
+
+    // select the block of transitions for the current state, returns true if one fired
+    bool dispatch(InputsType& input) {
+        const auto current = index(m_current_state);
+
+        // a state without transitions past the last one that has any
+        if(current >= state_count) {
+            return false;
+        }
+
+        return (this->*handlers[current])(input);
+    }
+
+    // the number the profiler knows each entry of Transitions by, static_skips aren't numbered
+    static constexpr std::array<std::size_t, sizeof...(Transitions)> numbers = [] {
+        std::array<std::size_t, sizeof...(Transitions)> out { };
+        std::size_t entry = 0, number = 0;
+
+        ((out[entry++] = Transitions::skips ? number : number++), ...);
+        return out;
+    }();
+
+    // tell the profiler about a transition, in declaration order so it gets its number
+    template <typename Transition>
+    constexpr void describe() {
+        if constexpr(!Transition::skips) {
+            m_profile.add_transition(index(Transition::initial_state), index(Transition::transition_state));
+        }
+    }
+
+    // test each transition leaving State, in declaration order, until one fires
+    template <std::size_t State>
+    bool tick_state(InputsType& input) {
+        return tick_state<State>(input, std::index_sequence_for<Transitions...>{});
+    }
+
+    template <std::size_t State, std::size_t... Entry>
+    bool tick_state(InputsType& input, std::index_sequence<Entry...>) {
+        return (try_transition<State, Transitions, Entry>(input) || ...);
+    }
+
+    template <std::size_t State, typename Transition, std::size_t Entry>
+    bool try_transition(InputsType& input) {
+        if constexpr(!Transition::skips && index(Transition::initial_state) == State) {
+            if(Transition::test_transition_condition(input)) {
+                Transition::run_transition_callback(input);
+                m_current_state = Transition::transition_state;
+                m_profile.fired(numbers[Entry]);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    template <typename Skip>
+    bool try_skip(InputsType& input, const char*& it, const char* end) {
+        if constexpr(Skip::skips) {
+            if(m_current_state == Skip::initial_state) {
+                const auto state = index(m_current_state);
+                m_profile.start_skip(state);
+
+                const char* stop = Skip::skip(input, it, end);
+                m_profile.skipped(state, stop - it);
+                m_profile.stop(state);
+
+                it = stop;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    States m_current_state;
+
+    [[no_unique_address]] Profiler m_profile;
+};
+
+/**
+ * A static_finite_state_machine that records nothing, see basic_static_finite_state_machine
+ */
+template <typename States, typename InputsType, typename... Transitions>
+using static_finite_state_machine = basic_static_finite_state_machine<States, InputsType, no_profiling,
+                                                                      Transitions...>;
+
+/**
+ * A static_finite_state_machine that records its ticks, transitions and time per state into a profiler
+ * Every tick reads the clock, so it is much slower, it is for finding where the time goes
+ */
+template <typename States, typename InputsType, typename... Transitions>
+using profiled_static_finite_state_machine = basic_static_finite_state_machine<States, InputsType, profiler,
+                                                                               Transitions...>;
+
+}
+
+#endif //MIPS_ASM_STATIC_FINITE_STATE_MACHINE_HPP
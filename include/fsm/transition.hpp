@@ -99,10 +99,18 @@ public:
     /**
      * @return Get the transition callback
      */
-    transition_callback_func get_transition_callback() const {
+    const transition_callback_func& get_transition_callback() const {
         return m_transition_callback_func;
     }
 
+    /**
+     * Run the transition callback against the input, without copying it
+     * @param inputs The input set
+     */
+    void run_transition_callback(InputsType& inputs) const {
+        m_transition_callback_func(inputs);
+    }
+
 private:
     /**
      * The current state
@@ -7,7 +7,6 @@
 
 #include <vector>
 #include <map>
-#include <optional>
 #include "transition.hpp"
 
 namespace as {
@@ -32,26 +31,24 @@ public:
      * Test a state for transition against an input value
      * @param state The state
      * @param inputs The input type
-     * @return An optional of transition
+     * @return The first transition whose condition matches, or nullptr if there is none
      */
-    std::optional<transition<States, InputsType>>
+    const transition<States, InputsType>*
     test_for_transitions(const States& state, InputsType& inputs) const {
+        auto it = m_table.find(state);
 
         /* if the state has transitions */
-        if(m_table.count(state)) {
+        if(it != m_table.end()) {
             /* check each possible transition this state can undergo,
              * if one matches the correct condition (against the input value) it means a transition has to occur */
-            for(auto& transition : m_table.at(state)) {
-
-
-                if(transition.get_initial_state() == state
-                        && transition.test_transition_condition(inputs)) {
-                    return transition;
+            for(auto& transition : it->second) {
+                if(transition.test_transition_condition(inputs)) {
+                    return &transition;
                 }
             }
         }
 
-        return std::nullopt;
+        return nullptr;
     }
 
 private:
@@ -0,0 +1,54 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#ifndef MIPS_ASM_MAPPED_FILE_HPP
+#define MIPS_ASM_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace as {
+
+/**
+ * A file mapped read-only into memory, the mapping lives as long as this object
+ * The kernel is told we read it sequentially, so it reads ahead aggressively
+ */
+class mapped_file {
+public:
+    /**
+     * Map a file
+     * @param path Path to the file
+     * @return The mapped file, or nullopt if it could not be opened or mapped
+     */
+    static std::optional<mapped_file> open(const std::string& path);
+
+    mapped_file(mapped_file&& other) noexcept;
+    mapped_file& operator=(mapped_file&& other) noexcept;
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    ~mapped_file();
+
+    /**
+     * @return The contents of the file, valid while this object is alive
+     */
+    std::string_view contents() const {
+        return { static_cast<const char*>(m_data), m_size };
+    }
+
+private:
+    mapped_file(void* data, std::size_t size);
+
+    void unmap();
+
+    void* m_data = nullptr;
+    std::size_t m_size = 0;
+};
+
+}
+
+#endif //MIPS_ASM_MAPPED_FILE_HPP
@@ -0,0 +1,92 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#ifndef MIPS_ASM_CHAR_CLASS_HPP
+#define MIPS_ASM_CHAR_CLASS_HPP
+
+#include <array>
+#include <cstddef>
+
+namespace as {
+
+/**
+ * A set of characters, stored as a 256 entry lookup table indexed by byte value
+ * Testing if a character is in the class is a single indexed load
+ *
+ * Classes are built at compile time and combined with | and ~, i.e.
+ *  constexpr char_class ident = char_class::range('a','z') | char_class("_");
+ */
+class char_class {
+public:
+    constexpr char_class() = default;
+
+    /**
+     * Create a class containing every character of a string
+     * @param chars Null terminated characters to include
+     */
+    constexpr char_class(const char* chars) {
+        for(; *chars != '\0'; ++chars) {
+            m_table[index(*chars)] = true;
+        }
+    }
+
+    /**
+     * Create a class containing an inclusive range of characters
+     * @param first First character, i.e 'a'
+     * @param last  Last character, i.e 'z'
+     */
+    static constexpr char_class range(char first, char last) {
+        char_class cls;
+
+        for(std::size_t i = index(first); i <= index(last); ++i) {
+            cls.m_table[i] = true;
+        }
+
+        return cls;
+    }
+
+    /**
+     * @return A class containing characters in either class
+     */
+    constexpr char_class operator|(const char_class& other) const {
+        char_class cls;
+
+        for(std::size_t i = 0; i < cls.m_table.size(); ++i) {
+            cls.m_table[i] = m_table[i] || other.m_table[i];
+        }
+
+        return cls;
+    }
+
+    /**
+     * @return A class containing every character not in this class
+     */
+    constexpr char_class operator~() const {
+        char_class cls;
+
+        for(std::size_t i = 0; i < cls.m_table.size(); ++i) {
+            cls.m_table[i] = !m_table[i];
+        }
+
+        return cls;
+    }
+
+    /**
+     * @return true if the character is in this class
+     */
+    constexpr bool contains(char ch) const {
+        return m_table[index(ch)];
+    }
+
+private:
+    static constexpr std::size_t index(char ch) {
+        return static_cast<unsigned char>(ch);
+    }
+
+    std::array<bool, 256> m_table = { };
+};
+
+}
+
+#endif //MIPS_ASM_CHAR_CLASS_HPP
@@ -0,0 +1,50 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#ifndef MIPS_ASM_DIAGNOSTIC_HPP
+#define MIPS_ASM_DIAGNOSTIC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace as {
+
+/**
+ * How serious a diagnostic is, in increasing order
+ */
+enum class severity : std::uint8_t {
+    TRACE,   // what the assembler did, only reported by builds without NDEBUG
+    NOTE,
+    WARNING, // the source is assembled, but likely not as the user meant
+    ERROR    // the source can't be assembled
+};
+
+// traces are compiled out of release builds, see diagnostic_sink::trace
+#ifdef NDEBUG
+constexpr bool trace_enabled = false;
+#else
+constexpr bool trace_enabled = true;
+#endif
+
+/**
+ * Something found in the source, i.e. an invalid token
+ */
+struct diagnostic {
+    // offset in the source where the error starts
+    std::uint32_t offset;
+
+    // the same as a line and column, both counted from 0, see as::line_index
+    std::size_t line;
+    std::size_t column;
+
+    // what is wrong, i.e. "Invalid register near 'xx'"
+    std::string reason;
+
+    severity level = severity::ERROR;
+};
+
+}
+
+#endif //MIPS_ASM_DIAGNOSTIC_HPP
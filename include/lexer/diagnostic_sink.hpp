@@ -0,0 +1,141 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#ifndef MIPS_ASM_DIAGNOSTIC_SINK_HPP
+#define MIPS_ASM_DIAGNOSTIC_SINK_HPP
+
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "diagnostic.hpp"
+#include "line_index.hpp"
+
+namespace as {
+
+/**
+ * Where the lexer and emitter send diagnostics
+ * Messages are passed as callables that build them, so nothing is formatted or allocated
+ * unless the sink wants a diagnostic of that severity
+ */
+class diagnostic_sink {
+public:
+    /**
+     * @param least The least severe diagnostic the sink wants, less severe ones are never built
+     */
+    explicit diagnostic_sink(severity least = severity::NOTE) :
+        m_least(least)
+    {
+
+    }
+
+    virtual ~diagnostic_sink() = default;
+
+    /**
+     * @return true if diagnostics of a severity are wanted
+     */
+    bool wants(severity level) const {
+        return level >= m_least && (level != severity::TRACE || trace_enabled);
+    }
+
+    /**
+     * Report a diagnostic if it is wanted
+     * @param level   Its severity
+     * @param offset  Offset in the source it is about
+     * @param message Returns the reason as a std::string, only called if the diagnostic is wanted
+     */
+    template <typename Message>
+    void report(severity level, std::uint32_t offset, Message&& message) {
+        if(wants(level)) {
+            accept({ offset, 0, 0, message(), level });
+        }
+    }
+
+    /**
+     * Report what the assembler did, traces are removed at compile time from builds with NDEBUG
+     * @param offset  As report()
+     * @param message As report()
+     */
+    template <typename Message>
+    void trace(std::uint32_t offset, Message&& message) {
+        if constexpr (trace_enabled) {
+            report(severity::TRACE, offset, message);
+        }
+    }
+
+    /**
+     * Report a diagnostic that was already built, i.e. by the lexer
+     */
+    void report(diagnostic error) {
+        if(wants(error.level)) {
+            accept(std::move(error));
+        }
+    }
+
+protected:
+    /**
+     * Take a wanted diagnostic, its line and column are 0 unless whoever reported it had the source
+     */
+    virtual void accept(diagnostic&& error) = 0;
+
+private:
+    severity m_least;
+};
+
+/**
+ * Collects diagnostics, in the order they were reported
+ */
+class diagnostic_list : public diagnostic_sink {
+public:
+    explicit diagnostic_list(severity least = severity::NOTE) :
+        diagnostic_sink(least)
+    {
+
+    }
+
+    const std::vector<diagnostic>& diagnostics() const {
+        return m_diagnostics;
+    }
+
+    /**
+     * @return true if an error was reported
+     */
+    bool has_errors() const;
+
+protected:
+    void accept(diagnostic&& error) override;
+
+private:
+    std::vector<diagnostic> m_diagnostics;
+};
+
+/**
+ * Writes diagnostics to a stream as they are reported, i.e. "warning: <reason> at line 1, column 4"
+ */
+class diagnostic_printer : public diagnostic_sink {
+public:
+    /**
+     * @param out    Where the diagnostics are written
+     * @param source If set, the source the diagnostics' offsets are in, it must outlive the printer
+     *               Their line and column are then found in it, otherwise they are written as reported
+     * @param least  As diagnostic_sink
+     */
+    explicit diagnostic_printer(std::ostream& out,
+                                std::optional<std::string_view> source = std::nullopt,
+                                severity least = severity::NOTE);
+
+protected:
+    void accept(diagnostic&& error) override;
+
+private:
+    std::ostream& m_out;
+    std::optional<line_index> m_lines;
+};
+
+}
+
+#endif //MIPS_ASM_DIAGNOSTIC_SINK_HPP
@@ -0,0 +1,153 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#ifndef MIPS_ASM_GENERATOR_HPP
+#define MIPS_ASM_GENERATOR_HPP
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+namespace as {
+
+/**
+ * A coroutine that lazily produces a sequence of values, each co_yield suspends it until the next value is wanted
+ * The yielded value stays in the coroutine, it is only valid until the generator is advanced
+ *
+ *  generator<int> count() { for(int i = 0;; ++i) co_yield i; }
+ *
+ *  for(auto& i : count()) { ... }
+ */
+template <typename T>
+class generator {
+public:
+    struct promise_type {
+        const T* m_value = nullptr;
+
+        generator get_return_object() {
+            return generator(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept { return { }; }
+        std::suspend_always final_suspend() noexcept { return { }; }
+
+        std::suspend_always yield_value(const T& value) noexcept {
+            m_value = std::addressof(value);
+            return { };
+        }
+
+        void return_void() noexcept { }
+
+        void unhandled_exception() {
+            throw;
+        }
+    };
+
+    using handle = std::coroutine_handle<promise_type>;
+
+    /**
+     * Advancing the iterator resumes the coroutine until its next value
+     */
+    class iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type        = T;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const T*;
+        using reference         = const T&;
+
+        iterator() = default;
+
+        explicit iterator(handle coroutine) :
+            m_coroutine(coroutine)
+        {
+
+        }
+
+        const T& operator*() const {
+            return *m_coroutine.promise().m_value;
+        }
+
+        const T* operator->() const {
+            return m_coroutine.promise().m_value;
+        }
+
+        iterator& operator++() {
+            m_coroutine.resume();
+            return *this;
+        }
+
+        void operator++(int) {
+            ++*this;
+        }
+
+        // the end is reached when the coroutine returns
+        bool operator==(std::default_sentinel_t) const {
+            return !m_coroutine || m_coroutine.done();
+        }
+
+    private:
+        handle m_coroutine = nullptr;
+    };
+
+    generator(const generator&) = delete;
+    generator& operator=(const generator&) = delete;
+
+    generator(generator&& other) noexcept :
+        m_coroutine(std::exchange(other.m_coroutine, nullptr))
+    {
+
+    }
+
+    generator& operator=(generator&& other) noexcept {
+        if(this != &other) {
+            destroy();
+            m_coroutine = std::exchange(other.m_coroutine, nullptr);
+        }
+
+        return *this;
+    }
+
+    ~generator() {
+        destroy();
+    }
+
+    /**
+     * Run the coroutine until its first value, the generator can only be iterated once
+     */
+    iterator begin() {
+        if(m_coroutine) {
+            m_coroutine.resume();
+        }
+
+        return iterator(m_coroutine);
+    }
+
+    std::default_sentinel_t end() const {
+        return { };
+    }
+
+private:
+    explicit generator(handle coroutine) :
+        m_coroutine(coroutine)
+    {
+
+    }
+
+    void destroy() {
+        if(m_coroutine) {
+            m_coroutine.destroy();
+            m_coroutine = nullptr;
+        }
+    }
+
+    handle m_coroutine = nullptr;
+};
+
+}
+
+#endif //MIPS_ASM_GENERATOR_HPP
@@ -0,0 +1,71 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#ifndef MIPS_ASM_INTERNER_HPP
+#define MIPS_ASM_INTERNER_HPP
+
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "string_arena.hpp"
+
+namespace as {
+
+/**
+ * Maps each distinct symbol (label, mnemonic, directive) to a dense id, starting at 0
+ * One interner is shared by everything in an assembly job, so symbols can be compared and indexed by id
+ * The names are copied into the interner and stay valid as long as it does
+ */
+class interner {
+public:
+    interner() = default;
+
+    interner(const interner&) = delete;
+    interner& operator=(const interner&) = delete;
+
+    interner(interner&&) = default;
+    interner& operator=(interner&&) = default;
+
+    /**
+     * Get the id of a symbol, adding it if it hasn't been seen before
+     * @param name The symbol
+     * @return Its id
+     */
+    std::uint32_t intern(std::string_view name);
+
+    /**
+     * Get the id of a symbol without adding it
+     * @param name The symbol
+     * @return Its id, or nullopt if it has never been interned
+     */
+    std::optional<std::uint32_t> find(std::string_view name) const;
+
+    /**
+     * @param id An id returned by intern()
+     * @return The symbol, valid as long as the interner is
+     */
+    std::string_view name(std::uint32_t id) const {
+        return m_names[id];
+    }
+
+    /**
+     * @return The number of distinct symbols, ids are below this
+     */
+    std::size_t size() const {
+        return m_names.size();
+    }
+
+private:
+    // the names, so they don't move as the map grows
+    string_arena m_arena;
+
+    std::vector<std::string_view> m_names;
+    std::unordered_map<std::string_view, std::uint32_t> m_ids;
+};
+
+}
+
+#endif //MIPS_ASM_INTERNER_HPP
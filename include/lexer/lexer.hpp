@@ -6,28 +6,153 @@
 #define MIPS_ASM_LEXER_HPP
 
 #include <cstdint>
+#include <functional>
+#include <optional>
+#include <string_view>
 #include <variant>
-#include <sstream>
-
-#include "../fsm/finite_state_machine.hpp"
-#include "../fsm/transition.hpp"
-
+#include <vector>
 
+#include "../fsm/profiler.hpp"
+#include "diagnostic.hpp"
+#include "diagnostic_sink.hpp"
+#include "generator.hpp"
+#include "interner.hpp"
 #include "lexer_context.hpp"
 #include "token.hpp"
+#include "token_stream.hpp"
 
 namespace as {
 
+/**
+ * The lexer holds no state of its own, its FSM's transitions are compile time data
+ * and everything a call mutates lives in a lexer_context on that call's stack,
+ * so one lexer can be shared by any number of threads lexing at once without locking
+ */
 class lexer {
 public:
-    lexer();
+    lexer() = default;
     virtual ~lexer() = default;
 
+    /**
+     * Token and diagnostic offsets are 32 bits, a larger source is rejected with an error
+     * rather than its offsets wrapping. A NEW_LINE may be pushed one past the last byte, so that offset must fit too
+     */
+    static constexpr std::size_t max_source_size = 0xFFFFFFFF;
+
     /**
      * Convert a string of MIPS assembly into tokens
-     * @returns vector of token
+     * The input is walked once, in place, so buffers that are memory mapped or owned elsewhere are not copied
+     * @param input   The assembly source
+     * @param storage With attribute_storage::BORROWED symbols reference input rather than being copied,
+     *                input must then outlive the tokens
+     * @param symbols If set, labels, mnemonics and directives are interned into it rather than stored per token,
+     *                it must then outlive the tokens, an interner is not synchronised so concurrent calls need their own
+     * @returns The tokens, or nullopt if there were invalid tokens, they are printed
+     */
+    std::optional<token_stream> lex(std::string_view input,
+                                          attribute_storage storage = attribute_storage::OWNED,
+                                          interner* symbols = nullptr) const;
+
+    /**
+     * Like lex(), but invalid tokens are reported to a sink rather than printed
+     * @param sink    Each error found is reported to it, located, in the order they appear
+     * @param storage As lex()
+     * @param symbols As lex()
+     * @returns The tokens, or nullopt if there were invalid tokens
+     */
+    std::optional<token_stream> lex(std::string_view input, diagnostic_sink& sink,
+                                    attribute_storage storage = attribute_storage::OWNED,
+                                    interner* symbols = nullptr) const;
+
+    /**
+     * Like lex(), but lexing carries on past invalid tokens so every error in the source is found in one pass
+     * After an error the rest of its line is skipped, and its statement is replaced by a single INVALID_TOKEN
+     * whose attribute is the reason, followed by the line's NEW_LINE
+     * @param diagnostics Each error found is added to it, in the order they appear
+     * @param storage     As lex()
+     * @param symbols     As lex()
+     * @returns The tokens
+     */
+    token_stream lex(std::string_view input, std::vector<diagnostic>& diagnostics,
+                     attribute_storage storage = attribute_storage::OWNED, interner* symbols = nullptr) const;
+
+    /**
+     * Like lex(), but every tick of the lexer's FSM is recorded, to find where lexing spends its time
+     * The clock is read on each tick, so this is much slower than lex()
+     * @param profile Replaced with the ticks, transitions and time of each state, named as in lexer::states
+     * @param sink    As lex() with a sink
+     * @param storage As lex()
+     * @param symbols As lex()
+     * @returns As lex() with a sink
+     */
+    std::optional<token_stream> lex(std::string_view input, profiler& profile, diagnostic_sink& sink,
+                                    attribute_storage storage = attribute_storage::OWNED,
+                                    interner* symbols = nullptr) const;
+
+    /**
+     * Like lex(), but large inputs are cut into slices at newlines which are lexed concurrently
+     * Statements never span lines, so each slice can start from scratch,
+     * string and character literals containing newlines are detected where slices meet and lexed again
+     * @param input   The assembly source
+     * @param sink    As lex() with a sink, errors are reported in the order they appear
+     * @param threads Number of threads to lex with, 0 for one per hardware thread
+     * @param storage As lex()
+     * @param symbols As lex(), ids are assigned in the order symbols appear in the input
+     * @returns The tokens, identical to what lex() returns, or nullopt if there were invalid tokens
+     */
+    std::optional<token_stream> lex_parallel(std::string_view input, diagnostic_sink& sink, unsigned threads = 0,
+                                             attribute_storage storage = attribute_storage::OWNED,
+                                             interner* symbols = nullptr) const;
+
+    /**
+     * Like lex(), but the tokens are produced lazily a statement at a time rather than all at once,
+     * so only the tokens of one statement exist at any point
+     * A statement is the tokens of a line up to and including its NEW_LINE, lines without any other tokens are skipped
+     * @param input   The assembly source, it must outlive the generator
+     * @param sink    Each error is reported to it before its statement is produced, it must outlive the generator
+     * @param storage As lex()
+     * @param symbols As lex()
+     * @returns Each statement, it is only valid until the generator is advanced. A statement with an invalid token
+     *          is produced as the INVALID_TOKEN and its NEW_LINE, as lex() with diagnostics does, and lexing goes on
+     */
+    generator<token_stream> statements(std::string_view input, diagnostic_sink& sink,
+                                       attribute_storage storage = attribute_storage::OWNED,
+                                       interner* symbols = nullptr) const;
+
+    /**
+     * Lines of a source that were replaced by an edit, a line includes the newline ending it
      */
-    std::optional<std::vector<token>> lex(const std::string& input);
+    struct line_edit {
+        // first line that changed
+        std::size_t first_line = 0;
+
+        // how many lines were replaced in the old source
+        std::size_t removed_lines = 0;
+
+        // how many lines replaced them in the new source
+        std::size_t inserted_lines = 0;
+    };
+
+    /**
+     * Update the tokens of a source after some of its lines changed, only lexing the lines that did
+     * The new tokens are spliced in and the offsets of the tokens after them shifted. If the edit opens or closes
+     * a string or character literal that spans lines, the rest of the source is lexed again
+     * @param tokens  The tokens of the source before the edit, from lex() or relex(). The old lines are counted
+     *                from them, so literals they borrow from the old source must still be readable
+     * @param source  The source after the edit
+     * @param edit    The lines that changed
+     * @param sink    As lex() with a sink
+     * @param storage As lex(), the tokens that aren't lexed again keep referencing whatever they did
+     * @param symbols As lex(), it must be the interner the tokens were lexed with
+     * @return false if an invalid token was found, tokens are then left as they were
+     */
+    bool relex(token_stream& tokens, std::string_view source, const line_edit& edit, diagnostic_sink& sink,
+               attribute_storage storage = attribute_storage::OWNED, interner* symbols = nullptr) const;
+
+    /**
+     * Lexes a source that is passed in chunks, defined below
+     */
+    class stream;
 
 private:
     /**
@@ -67,16 +192,73 @@ private:
         //      ^^^
         SEEK_IMM_REG,
 
-        // An unexpected, unknown token
-        INVALID_TOKEN = -1
+        // An unexpected, unknown token, the rest of the line is skipped
+        INVALID_TOKEN
     };
 
-    /*
-     * Loads transitions into the FSM
+    /**
+     * The lexer's FSM, its transitions are known at compile time and defined in lexer.cpp
+     */
+    struct fsm;
+
+public:
+    /**
+     * Lexes a source that is passed in chunks, so it never needs to be in memory at once
+     * The FSM state and any lexeme cut off at the end of a chunk are carried over to the next,
+     * tokens are passed to a callback as they are lexed rather than collected
      */
-    void setup_fsm();
+    class stream {
+    public:
+        using token_callback = std::function<void(token&&)>;
+
+        /**
+         * @param callback Called with each token in order, from within feed() and finish()
+         * @param sink     The first invalid token is reported to it, with its line and column,
+         *                 it must outlive the stream
+         * @param storage  With attribute_storage::BORROWED symbols reference the chunk being fed,
+         *                 they are only valid until the callback returns
+         * @param symbols  As lex()
+         * @param base     Offset of the first byte fed within the whole source, i.e. when resuming partway into a file,
+         *                 tokens and errors are at offsets from the start of the source. Lines are counted from it
+         */
+        stream(token_callback callback, diagnostic_sink& sink, attribute_storage storage = attribute_storage::OWNED,
+               interner* symbols = nullptr, std::size_t base = 0);
+
+        /**
+         * Lex the next chunk of the source, chunks may be cut anywhere
+         * @param chunk The chunk, it only needs to live until feed returns
+         * @return false if an invalid token was found, or the source grew past lexer::max_source_size,
+         *         the stream then rejects any further input
+         */
+        bool feed(std::string_view chunk);
+
+        /**
+         * End the source, ending the last line if the source didn't
+         * @return false if an invalid token was found
+         */
+        bool finish();
 
-    finite_state_machine<states, lexer_context> m_fsm;
+    private:
+        // pass the buffered tokens to the callback
+        void flush();
+
+        // report the errors found, with their line and column, the chunk is the one being fed
+        void report_errors(std::string_view chunk) const;
+
+        token_callback m_callback;
+        diagnostic_sink& m_sink;
+        lexer_context m_context;
+        states m_state;
+
+        // offset of the current chunk in the source, lines fed before it, and the offset the current line starts at
+        std::size_t m_fed = 0;
+        std::size_t m_lines = 0;
+        std::size_t m_line_begin = 0;
+
+        // whether the last character fed was a newline, or nothing has been fed
+        bool m_at_line_start = true;
+        bool m_failed = false;
+    };
 };
 
 }
@@ -5,10 +5,16 @@
 #ifndef MIPS_ASM_LEXER_CONTEXT_HPP
 #define MIPS_ASM_LEXER_CONTEXT_HPP
 
+#include <algorithm>
+#include <cstdint>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
+#include "diagnostic.hpp"
+#include "interner.hpp"
 #include "token.hpp"
-#include <sstream>
+#include "token_stream.hpp"
 #include <variant>
 
 namespace as {
@@ -21,6 +27,20 @@ namespace as {
  */
 class lexer_context {
 public:
+    /**
+     * @param source  The input being lexed, lexemes are spans of it
+     * @param storage Whether pushed tokens copy their symbol, or reference the source
+     * @param symbols If set, labels, mnemonics and directives are interned into it regardless of storage
+     */
+    explicit lexer_context(std::string_view source, attribute_storage storage = attribute_storage::OWNED,
+                           interner* symbols = nullptr) :
+        m_source(source),
+        m_storage(storage),
+        m_symbols(symbols)
+    {
+
+    }
+
     /**
      * Get the character that has been passed as an input to the fsm
      * @return
@@ -32,82 +52,274 @@ public:
     /**
      * Set the char to be passed
      * @param ch
+     * @param pos Offset of the character in the source
      */
-    void set_ch(const char& ch) {
+    void set_ch(const char& ch, const std::size_t& pos) {
         m_char = ch;
+        m_pos = pos;
     }
 
     /**
-     * Get current line
-     * @return current line
+     * Set the offset of the source within the whole input, tokens are pushed with offsets relative to the input
+     * @param base Offset of the first character of the source
      */
-    const std::size_t& cur_line() {
-        return m_line;
+    void set_base(const std::size_t& base) {
+        m_base = base;
     }
 
     /**
-     * Set the current line
-     * @param line
+     * Consume the current character into the lexeme
      */
-    void set_cur_line(const size_t& line) {
-        m_line = line;
+    void consume() {
+        consume(m_pos, m_pos + 1);
     }
 
     /**
-     * Consume a character into the character buffer
-     * @param ch character
+     * Consume a span of characters into the lexeme
+     * @param begin Offset of the first character in the source
+     * @param end   Offset one past the last character
      */
-     void consume(const char& ch) {
-         m_buffer << ch;
-     }
+    void consume(const std::size_t& begin, const std::size_t& end) {
+        // the lexeme started in a previous source, keep appending to the copy of it
+        if(m_carrying) {
+            m_carry.append(m_source.substr(begin, end - begin));
+            return;
+        }
+
+        if(m_lexeme_begin == m_lexeme_end) {
+            m_lexeme_begin = begin;
+        }
+
+        // the lexer may pass a newline past the end of the source
+        m_lexeme_end = std::min(end, m_source.size());
+    }
 
     /**
-     * Return the character buffer
-     * @return
+     * Consume a span of characters into the lexeme
+     * @param begin First character, within the source
+     * @param end   One past the last character
+     */
+    void consume_span(const char* begin, const char* end) {
+        consume(begin - m_source.data(), end - m_source.data());
+    }
+
+    /**
+     * The lexeme spans from the first character consumed to the last
+     * @return The lexeme, referencing the source
+     */
+    std::string_view lexeme() const {
+        if(m_carrying) {
+            return m_carry;
+        }
+
+        return m_source.substr(m_lexeme_begin, m_lexeme_end - m_lexeme_begin);
+    }
+
+    /**
+     * Clear the lexeme, does not clear the current character
      */
-    const std::stringstream& char_buffer() const {
-        return m_buffer;
+    void clear_lexeme() {
+        m_lexeme_begin = m_lexeme_end = 0;
+        m_carry.clear();
+        m_carrying = false;
     }
 
     /**
-     * Clear character buffer, does not clear hte current character
+     * Switch to the next chunk of a source that is being fed in pieces
+     * A lexeme that is still open is copied, so the previous chunk does not need to outlive it
+     * @param source The next chunk, offsets passed to set_ch and consume are now relative to it
      */
-    void clear_char_buffer() {
-        m_buffer.clear(); // clear string
-        m_buffer.str(""); // resets flags
+    void set_source(std::string_view source) {
+        if(!m_carrying && m_lexeme_begin != m_lexeme_end) {
+            m_carry.assign(lexeme());
+            m_carrying = true;
+        }
+
+        // offsets keep counting from the start of the first source
+        m_base += m_source.size();
+
+        m_source = source;
+        m_lexeme_begin = m_lexeme_end = 0;
     }
 
 
     /* The output tokens */
-    const std::vector<token>& tokens() const {
+    const token_stream& tokens() const {
         return m_tokens;
     }
 
+    /**
+     * Pass each output token to a callback, then empty the buffer keeping its capacity
+     * Tokens from the buffer reference its symbols, which are reused once it is emptied,
+     * so with attribute_storage::OWNED each token is given its own copy of its symbol
+     * @param callback Called with each token, in order
+     */
+    template <typename Callback>
+    void flush_tokens(Callback&& callback) {
+        for(std::size_t i = 0; i < m_tokens.size(); ++i) {
+            auto tk = m_tokens.at(i);
+
+            if(m_storage == attribute_storage::OWNED && tk.has_symbol() && !tk.symbol_id()) {
+                callback(token(tk.type(), tk.offset(), std::string(tk.symbol())));
+            } else {
+                callback(std::move(tk));
+            }
+        }
+
+        m_tokens.clear();
+    }
+
+    /**
+     * Remove the tokens of the current statement, those after the last NEW_LINE
+     */
+    void discard_statement() {
+        while(!m_tokens.empty() && m_tokens.type(m_tokens.size() - 1) != token_type::NEW_LINE) {
+            m_tokens.pop_back();
+        }
+    }
+
+    /**
+     * Record an error at the start of the current lexeme, or at the current character if there is none
+     * @param reason What is wrong
+     */
+    void report(std::string reason) {
+        // its line and column are found later, only if the diagnostic is shown
+        m_diagnostics.push_back({ token_offset(), 0, 0, std::move(reason) });
+    }
+
+    /**
+     * The errors reported so far, in the order they were found
+     */
+    const std::vector<diagnostic>& diagnostics() const {
+        return m_diagnostics;
+    }
+
+    /**
+     * Move the reported errors out of the context
+     */
+    std::vector<diagnostic> take_diagnostics() {
+        return std::move(m_diagnostics);
+    }
+
+    /**
+     * Empty the output token buffer, keeping its capacity
+     */
+    void clear_tokens() {
+        m_tokens.clear();
+    }
+
+    /**
+     * Move the output tokens out of the context
+     */
+    token_stream take_tokens() {
+        return std::move(m_tokens);
+    }
+
     /**
      * Add a token to the output token buffer
      * @param type  Token type
      * @param attr  Token attribute
      */
     void push_token(const token_type &type, const std::variant<std::string, std::int32_t> &attr = 0) {
-        m_tokens.emplace_back(token(type, m_line, attr));
+        if(std::holds_alternative<std::string>(attr)) {
+            m_tokens.push_owned_symbol(type, token_offset(), std::get<std::string>(attr));
+        } else {
+            m_tokens.push_number(type, token_offset(), std::get<std::int32_t>(attr));
+        }
+    }
+
+    /**
+     * Add a token with the current lexeme as its attribute to the output token buffer
+     * @param type  Token type
+     */
+    void push_lexeme_token(const token_type &type) {
+        // a carried lexeme is about to be cleared, so it can't be referenced
+        if(m_storage == attribute_storage::BORROWED && !m_carrying) {
+            m_tokens.push_symbol(type, token_offset(), lexeme());
+        } else {
+            m_tokens.push_owned_symbol(type, token_offset(), lexeme());
+        }
+    }
+
+    /**
+     * Intern the current lexeme
+     * @return Its id, or nullopt if the context has no interner
+     */
+    std::optional<std::uint32_t> intern_lexeme() {
+        if(m_symbols == nullptr) {
+            return std::nullopt;
+        }
+
+        return m_symbols->intern(lexeme());
+    }
+
+    /**
+     * Add a token with a symbol as its attribute to the output token buffer
+     * @param type Token type
+     * @param id   The symbol's id from intern_lexeme(), if nullopt this is the same as push_lexeme_token()
+     */
+    void push_symbol_token(const token_type &type, const std::optional<std::uint32_t>& id) {
+        if(!id.has_value()) {
+            return push_lexeme_token(type);
+        }
+
+        m_tokens.push_symbol(type, token_offset(), m_symbols->name(id.value()), id.value());
+    }
+
+    /**
+     * Per symbol id, whether the symbol is an instruction mnemonic, -1 if it hasn't been looked up yet
+     * This lets the lexer look up each distinct symbol once, rather than every time it occurs
+     */
+    std::vector<std::int8_t>& mnemonic_ids() {
+        return m_mnemonic_ids;
     }
 
 private:
+    /**
+     * Where a token pushed now starts in the input, the start of the lexeme or the current character if there is none
+     * The lexer rejects sources whose offsets wouldn't fit in 32 bits, see lexer::max_source_size
+     */
+    std::uint32_t token_offset() const {
+        if(m_carrying) {
+            return static_cast<std::uint32_t>(m_base + m_pos - m_carry.size());
+        }
+
+        if(m_lexeme_begin != m_lexeme_end) {
+            return static_cast<std::uint32_t>(m_base + m_lexeme_begin);
+        }
+
+        return static_cast<std::uint32_t>(m_base + m_pos);
+    }
+
     /*
      * The current character that has been passed to the lexer
      * Note: m_char is the only variable the lexer FSM depends on to determine state
      * The other variables are simple used for outputs
-     *
-     * Stored as an std::string to make passing to std::regex easier
      **/
     char m_char;
-    std::vector<token> m_tokens;
+    token_stream m_tokens;
+
+    /* The input, and offset of the current character within it */
+    std::string_view m_source;
+    std::size_t m_pos = 0;
+
+    /* The lexeme, [begin, end) offsets into the source */
+    std::size_t m_lexeme_begin = 0;
+    std::size_t m_lexeme_end = 0;
+
+    /* A lexeme that spans chunks is copied here, see set_source */
+    std::string m_carry;
+    bool m_carrying = false;
+
+    attribute_storage m_storage;
+
+    interner* m_symbols;
+    std::vector<std::int8_t> m_mnemonic_ids;
 
-    /* Character buffer */
-    std::stringstream m_buffer;
+    /* offset of the source within the whole input */
+    std::size_t m_base = 0;
 
-    /* current line */
-    std::size_t m_line;
+    std::vector<diagnostic> m_diagnostics;
 
 };
 
@@ -0,0 +1,62 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#ifndef MIPS_ASM_LINE_INDEX_HPP
+#define MIPS_ASM_LINE_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace as {
+
+/**
+ * A line and column in a source, both counted from 0
+ */
+struct source_location {
+    std::size_t line;
+    std::size_t column;
+};
+
+/**
+ * Maps byte offsets in a source, as tokens store them, to lines and columns
+ * The offset each line starts at is only found the first time a location is asked for,
+ * so a source that lexes cleanly is never scanned for its lines
+ */
+class line_index {
+public:
+    /**
+     * @param source The source, it must outlive the index
+     */
+    explicit line_index(std::string_view source) :
+        m_source(source)
+    {
+
+    }
+
+    /**
+     * Find the line and column of an offset, the line starts are binary searched
+     * @param offset Offset in the source, an offset past its end is on the last line
+     */
+    source_location locate(std::uint32_t offset);
+
+    /**
+     * @return Number of lines in the source, the last line counts even if it is empty
+     */
+    std::size_t lines();
+
+private:
+    // find the start of every line, the newlines are found 16 or 32 bytes at a time
+    void build();
+
+    std::string_view m_source;
+
+    // offset of the start of each line, empty until built
+    std::vector<std::uint32_t> m_starts;
+};
+
+}
+
+#endif //MIPS_ASM_LINE_INDEX_HPP
@@ -0,0 +1,114 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#ifndef MIPS_ASM_SCAN_HPP
+#define MIPS_ASM_SCAN_HPP
+
+#include <array>
+#include <cstddef>
+#include <initializer_list>
+#include <stdexcept>
+
+namespace as {
+
+/**
+ * An inclusive range of bytes, i.e. { 'a', 'z' }
+ */
+struct byte_range {
+    char first;
+    char last;
+};
+
+/**
+ * A small set of byte ranges that can be tested 16 or 32 bytes at a time
+ *
+ *  constexpr byte_ranges ident = { {'a','z'}, {'A','Z'}, {'0','9'}, {'_','_'} };
+ */
+class byte_ranges {
+public:
+    static constexpr std::size_t max_ranges = 4;
+
+    /**
+     * The scanners only test max_ranges ranges, so more is an error rather than some being dropped,
+     * a constexpr set with too many doesn't compile
+     */
+    constexpr byte_ranges(std::initializer_list<byte_range> ranges) {
+        if(ranges.size() > max_ranges) {
+            throw std::length_error("byte_ranges holds at most 4 ranges");
+        }
+
+        for(auto& range : ranges) {
+            m_ranges[m_size++] = range;
+        }
+    }
+
+    constexpr std::size_t size() const {
+        return m_size;
+    }
+
+    constexpr const byte_range& operator[](std::size_t i) const {
+        return m_ranges[i];
+    }
+
+    /**
+     * @return true if ch falls in one of the ranges
+     */
+    constexpr bool contains(char ch) const {
+        auto c = static_cast<unsigned char>(ch);
+
+        for(std::size_t i = 0; i < m_size; ++i) {
+            if(c >= static_cast<unsigned char>(m_ranges[i].first)
+                    && c <= static_cast<unsigned char>(m_ranges[i].last)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+private:
+    std::array<byte_range, max_ranges> m_ranges = { };
+    std::size_t m_size = 0;
+};
+
+/**
+ * Instruction sets the scanner can use, the best one the CPU supports is picked at startup
+ */
+enum class scan_isa {
+    SCALAR,
+    SSE2,
+    AVX2
+};
+
+/**
+ * @return The instruction set find_first_in and find_first_not_in are using
+ */
+scan_isa active_scan_isa();
+
+/**
+ * @return true if the CPU we are running on supports isa
+ */
+bool scan_isa_supported(scan_isa isa);
+
+/**
+ * Find the first byte in [begin, end) that falls in one of the ranges
+ * @return Pointer to the byte, or end if there is none
+ */
+const char* find_first_in(const char* begin, const char* end, const byte_ranges& ranges);
+
+/**
+ * Find the first byte in [begin, end) that does not fall in any of the ranges
+ * @return Pointer to the byte, or end if there is none
+ */
+const char* find_first_not_in(const char* begin, const char* end, const byte_ranges& ranges);
+
+/**
+ * As above, using a specific instruction set (which must be supported)
+ */
+const char* find_first_in(const char* begin, const char* end, const byte_ranges& ranges, scan_isa isa);
+const char* find_first_not_in(const char* begin, const char* end, const byte_ranges& ranges, scan_isa isa);
+
+}
+
+#endif //MIPS_ASM_SCAN_HPP
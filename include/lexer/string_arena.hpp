@@ -0,0 +1,68 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#ifndef MIPS_ASM_STRING_ARENA_HPP
+#define MIPS_ASM_STRING_ARENA_HPP
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace as {
+
+/**
+ * Copies strings into large blocks, so storing many small strings costs one allocation per block
+ * Stored strings never move, they stay valid until the arena is cleared or destroyed, moving the arena keeps them valid
+ */
+class string_arena {
+public:
+    string_arena() = default;
+
+    string_arena(const string_arena&) = delete;
+    string_arena& operator=(const string_arena&) = delete;
+
+    string_arena(string_arena&&) = default;
+    string_arena& operator=(string_arena&&) = default;
+
+    /**
+     * Copy a string into the arena
+     * @return The copy
+     */
+    std::string_view store(std::string_view str);
+
+    /**
+     * Take ownership of another arena's blocks, strings stored in it stay valid
+     */
+    void adopt(string_arena&& other);
+
+    /**
+     * Free every stored string, keeping one block to store the next in
+     */
+    void clear();
+
+    /**
+     * @return true if a string was stored in the arena, or in one it adopted
+     */
+    bool owns(const char* str) const;
+
+    /**
+     * @return Bytes of the strings stored in the arena, and in those it adopted
+     */
+    std::size_t size() const {
+        return m_stored;
+    }
+
+private:
+    // strings are copied into blocks of this size, or their own block if larger
+    static constexpr std::size_t block_size = 64 << 10;
+
+    std::vector<std::unique_ptr<char[]>> m_blocks;
+    std::size_t m_block_used = 0;
+    std::size_t m_stored = 0;
+};
+
+}
+
+#endif //MIPS_ASM_STRING_ARENA_HPP
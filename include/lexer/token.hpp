@@ -5,24 +5,76 @@
 #ifndef MIPS_ASM_TOKEN_HPP
 #define MIPS_ASM_TOKEN_HPP
 
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <variant>
 #include "token_type.hpp"
 
 namespace as {
 
+/**
+ * How the symbol attributes (labels, mnemonics, strings) of lexed tokens are stored
+ */
+enum class attribute_storage {
+    // Each token owns a copy of its symbol
+    OWNED,
+
+    // Each token references its symbol in the source, the source must outlive the tokens
+    BORROWED
+};
+
+/**
+ * A symbol attribute that has been interned, see as::interner
+ */
+struct interned_symbol {
+    std::uint32_t id;
+
+    // the name, owned by the interner
+    std::string_view name;
+};
+
 class token {
 public:
     /**
      * Create a token
-     * @param type Token type
-     * @param attr Custom attribute, typically a symbol or a number tagged to that token (e.g. a label name)
+     * @param type   Token type
+     * @param offset Offset of the token in its source, see as::line_index to find its line and column
+     * @param attr   Custom attribute, typically a symbol or a number tagged to that token (e.g. a label name)
      */
-    token(const token_type &type, const std::size_t& line, const std::variant <std::string, std::int32_t> &attr = 0) :
+    token(const token_type &type, const std::uint32_t& offset, const std::variant <std::string, std::int32_t> &attr = 0) :
             m_type(type),
-            m_attribute(attr),
-            m_line(line)
+            m_offset(offset)
     {
+        if(std::holds_alternative<std::string>(attr)) {
+            m_attribute = std::get<std::string>(attr);
+        } else {
+            m_attribute = std::get<std::int32_t>(attr);
+        }
+    }
 
+    /**
+     * Create a token whose symbol references a buffer instead of owning a copy,
+     * the buffer must outlive the token
+     * @param type   Token type
+     * @param symbol The symbol, i.e. the label name within the source
+     */
+    static token borrowing(const token_type &type, const std::uint32_t& offset, std::string_view symbol) {
+        token tk(type, offset);
+        tk.m_attribute = symbol;
+        return tk;
+    }
+
+    /**
+     * Create a token whose symbol has been interned, the interner must outlive the token
+     * @param type   Token type
+     * @param symbol The symbol's id and name from the interner
+     */
+    static token interned(const token_type &type, const std::uint32_t& offset, const interned_symbol& symbol) {
+        token tk(type, offset);
+        tk.m_attribute = symbol;
+        return tk;
     }
 
     /**
@@ -33,32 +85,94 @@ public:
     }
 
     /**
+     * Get the attribute as a number or an owned string,
+     * symbols referencing the source are copied out, use symbol() to avoid this
      * @return Variable associated with the token (either a number, or a symbol)
      */
-    const std::variant <std::string, std::int32_t>& attribute() const {
-        return m_attribute;
+    std::variant <std::string, std::int32_t> attribute() const {
+        if(std::holds_alternative<std::int32_t>(m_attribute)) {
+            return std::get<std::int32_t>(m_attribute);
+        }
+
+        return std::string(symbol());
+    }
+
+    /**
+     * @return The symbol attribute without copying it, empty if the attribute is a number
+     */
+    std::string_view symbol() const {
+        if(std::holds_alternative<std::string_view>(m_attribute)) {
+            return std::get<std::string_view>(m_attribute);
+        }
+
+        if(std::holds_alternative<std::string>(m_attribute)) {
+            return std::get<std::string>(m_attribute);
+        }
+
+        if(std::holds_alternative<interned_symbol>(m_attribute)) {
+            return std::get<interned_symbol>(m_attribute).name;
+        }
+
+        return { };
+    }
+
+    /**
+     * @return true if the attribute is a symbol rather than a number
+     */
+    bool has_symbol() const {
+        return !std::holds_alternative<std::int32_t>(m_attribute);
+    }
+
+    /**
+     * @return true if the token owns a copy of its symbol
+     */
+    bool owns_symbol() const {
+        return std::holds_alternative<std::string>(m_attribute);
+    }
+
+    /**
+     * @return The number attribute without copying the attribute out, 0 if the attribute is a symbol
+     */
+    std::int32_t number() const {
+        if(std::holds_alternative<std::int32_t>(m_attribute)) {
+            return std::get<std::int32_t>(m_attribute);
+        }
+
+        return 0;
+    }
+
+    /**
+     * @return The interned id of the symbol attribute, nullopt if it wasn't interned
+     */
+    std::optional<std::uint32_t> symbol_id() const {
+        if(std::holds_alternative<interned_symbol>(m_attribute)) {
+            return std::get<interned_symbol>(m_attribute).id;
+        }
+
+        return std::nullopt;
     }
 
     const std::string& name() const {
         return token_type_name.at(m_type);
     }
 
-    const std::size_t& line() const {
-        return m_line;
+    /**
+     * @return Offset of the token in its source
+     */
+    const std::uint32_t& offset() const {
+        return m_offset;
     }
 private:
     token_type m_type;
 
-    // line where the token was found
-    std::size_t m_line;
+    // byte offset in the source where the token was found
+    std::uint32_t m_offset;
 
     /*
-     * An optional attribute that the token may have
-     * may be memory intensive,
-     * i.e symbols will be repeated rather than storing a reference to a dictionary
-     * TODO: consider optimizing this
+     * An optional attribute that the token may have,
+     * symbols are either owned, reference the source the token was lexed from or are interned
      */
-    std::variant <std::string, std::int32_t> m_attribute;
+    std::variant <std::int32_t, std::string_view, std::string, interned_symbol> m_attribute;
 };
 
 }
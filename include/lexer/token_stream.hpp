@@ -0,0 +1,332 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#ifndef MIPS_ASM_TOKEN_STREAM_HPP
+#define MIPS_ASM_TOKEN_STREAM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <string_view>
+#include <vector>
+#include "string_arena.hpp"
+#include "token.hpp"
+#include "token_type.hpp"
+
+namespace as {
+
+/**
+ * A sequence of tokens stored as parallel arrays rather than as token objects
+ * Each token is a one byte type, a 32-bit source offset and a 32-bit attribute, 9 bytes instead of sizeof(token),
+ * so scanning the types (i.e. to find the end of each statement) only touches the types
+ *
+ * A number attribute is stored in place, a symbol attribute is an index into a pool of symbols,
+ * symbols either reference the source, an interner, or are copied into an arena owned by the stream
+ * Each pool entry is a pointer, size and id, so a token with a symbol costs 25 bytes, see bytes_per_token()
+ *
+ * Reading a token produces an as::token whose symbol references the stream, so it is valid as long as the stream
+ */
+class token_stream {
+public:
+    class const_iterator;
+
+    token_stream() = default;
+
+    token_stream(const token_stream&) = delete;
+    token_stream& operator=(const token_stream&) = delete;
+
+    token_stream(token_stream&&) = default;
+    token_stream& operator=(token_stream&&) = default;
+
+    /**
+     * Add a token, a symbol it owns is copied into the stream, one it references (from token::borrowing or
+     * token::interned) is referenced by the stream too
+     */
+    void push_back(const token& tk);
+
+    /**
+     * Add a token with a number attribute
+     */
+    void push_number(token_type type, std::uint32_t offset, std::int32_t value) {
+        push(type, offset, static_cast<std::uint32_t>(value));
+    }
+
+    /**
+     * Add a token with a symbol attribute referencing a buffer, the buffer must outlive the stream
+     * @param id The symbol's interned id, if it has one
+     */
+    void push_symbol(token_type type, std::uint32_t offset, std::string_view symbol, std::uint32_t id = no_id) {
+        m_symbols.push_back({ symbol.data(), static_cast<std::uint32_t>(symbol.size()), id });
+        push(static_cast<token_type>(static_cast<std::uint8_t>(type) | symbol_flag), offset,
+             static_cast<std::uint32_t>(m_symbols.size() - 1));
+    }
+
+    /**
+     * Add a token with a symbol attribute that is copied into the stream
+     */
+    void push_owned_symbol(token_type type, std::uint32_t offset, std::string_view symbol) {
+        push_symbol(type, offset, m_arena.store(symbol));
+    }
+
+    /**
+     * Move the tokens of another stream onto the end of this one
+     */
+    void append(token_stream&& other);
+
+    /**
+     * Replace the tokens [first, last) with those of another stream
+     * The removed tokens' symbols leave the pool, their owned copies are freed once they outnumber
+     * the symbols that are kept, so repeated splices don't grow the stream
+     * @param offset_shift Added to the offset of every token after the replaced ones
+     */
+    void splice(std::size_t first, std::size_t last, token_stream&& replacement, std::ptrdiff_t offset_shift);
+
+    /**
+     * Replace the symbol of a token with an interned one
+     * @param index Token with a symbol attribute
+     */
+    void set_interned_symbol(std::size_t index, const interned_symbol& symbol) {
+        auto& sym = m_symbols[m_values[index]];
+        sym = { symbol.name.data(), static_cast<std::uint32_t>(symbol.name.size()), symbol.id };
+    }
+
+    /**
+     * Read a token
+     */
+    token at(std::size_t index) const;
+
+    token operator[](std::size_t index) const {
+        return at(index);
+    }
+
+    token back() const {
+        return at(size() - 1);
+    }
+
+    /**
+     * Get the type of a token without reading the rest of it
+     */
+    token_type type(std::size_t index) const {
+        return static_cast<token_type>(m_types[index] & ~symbol_flag);
+    }
+
+    /**
+     * Get the source offset of a token without reading the rest of it
+     */
+    std::uint32_t offset(std::size_t index) const {
+        return m_offsets[index];
+    }
+
+    /**
+     * Find the first token at or after an offset, the offsets are binary searched
+     * @return Index of the token, or size() if there is none
+     */
+    std::size_t lower_bound_offset(std::uint32_t offset) const;
+
+    /**
+     * Get the symbol of a token without reading the rest of it, empty if the attribute is a number
+     */
+    std::string_view symbol(std::size_t index) const {
+        if((m_types[index] & symbol_flag) == 0) {
+            return { };
+        }
+
+        auto& sym = m_symbols[m_values[index]];
+        return { sym.data, sym.size };
+    }
+
+    /**
+     * Get the interned id of a token's symbol without reading the rest of it
+     * @return The id, or nullopt if the attribute isn't an interned symbol
+     */
+    std::optional<std::uint32_t> symbol_id(std::size_t index) const {
+        if((m_types[index] & symbol_flag) == 0 || m_symbols[m_values[index]].id == no_id) {
+            return std::nullopt;
+        }
+
+        return m_symbols[m_values[index]].id;
+    }
+
+    /**
+     * Get the number attribute of a token without reading the rest of it, 0 if the attribute is a symbol
+     */
+    std::int32_t number(std::size_t index) const {
+        if((m_types[index] & symbol_flag) != 0) {
+            return 0;
+        }
+
+        return static_cast<std::int32_t>(m_values[index]);
+    }
+
+    /**
+     * Find the next token of a type, the types are scanned 16 or 32 at a time
+     * @param type Type to find
+     * @param from Index to start at
+     * @return Index of the token, or size() if there is none
+     */
+    std::size_t find(token_type type, std::size_t from = 0) const;
+
+    std::size_t size() const {
+        return m_types.size();
+    }
+
+    /**
+     * @return Entries in the symbol pool, one per token with a symbol attribute
+     */
+    std::size_t symbol_count() const {
+        return m_symbols.size();
+    }
+
+    /**
+     * @return Bytes of the symbols the stream owns a copy of, including those of spliced out tokens not yet freed
+     */
+    std::size_t owned_bytes() const {
+        return m_arena.size();
+    }
+
+    bool empty() const {
+        return m_types.empty();
+    }
+
+    void reserve(std::size_t count);
+
+    /**
+     * Remove every token, keeping the capacity of the arrays
+     */
+    void clear();
+
+    /**
+     * Remove the last token
+     */
+    void pop_back();
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    /**
+     * @param has_symbol If the token's attribute is a symbol, it then also has an entry in the symbol pool
+     * @return Bytes used by a token, not counting an owned copy of its symbol
+     */
+    static constexpr std::size_t bytes_per_token(bool has_symbol) {
+        return sizeof(std::uint8_t) + sizeof(std::uint32_t) + sizeof(std::uint32_t) +
+               (has_symbol ? sizeof(symbol_entry) : 0);
+    }
+
+    /**
+     * Iterates over the tokens, yielding an as::token for each
+     */
+    class const_iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type        = token;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = void;
+        using reference         = token;
+
+        const_iterator() = default;
+
+        const_iterator(const token_stream* stream, std::size_t index) :
+            m_stream(stream),
+            m_index(index)
+        {
+
+        }
+
+        token operator*() const {
+            return m_stream->at(m_index);
+        }
+
+        token operator[](difference_type n) const {
+            return m_stream->at(m_index + n);
+        }
+
+        const_iterator& operator++() { ++m_index; return *this; }
+        const_iterator& operator--() { --m_index; return *this; }
+        const_iterator operator++(int) { auto it = *this; ++m_index; return it; }
+        const_iterator operator--(int) { auto it = *this; --m_index; return it; }
+
+        const_iterator& operator+=(difference_type n) { m_index += n; return *this; }
+        const_iterator& operator-=(difference_type n) { m_index -= n; return *this; }
+
+        const_iterator operator+(difference_type n) const { return { m_stream, m_index + n }; }
+        const_iterator operator-(difference_type n) const { return { m_stream, m_index - n }; }
+
+        difference_type operator-(const const_iterator& other) const {
+            return static_cast<difference_type>(m_index) - static_cast<difference_type>(other.m_index);
+        }
+
+        bool operator==(const const_iterator& other) const { return m_index == other.m_index; }
+        bool operator!=(const const_iterator& other) const { return m_index != other.m_index; }
+        bool operator<(const const_iterator& other) const  { return m_index < other.m_index; }
+        bool operator>(const const_iterator& other) const  { return m_index > other.m_index; }
+        bool operator<=(const const_iterator& other) const { return m_index <= other.m_index; }
+        bool operator>=(const const_iterator& other) const { return m_index >= other.m_index; }
+
+        /**
+         * @return Index of the token in the stream
+         */
+        std::size_t index() const {
+            return m_index;
+        }
+
+    private:
+        const token_stream* m_stream = nullptr;
+        std::size_t m_index = 0;
+    };
+
+private:
+    // set in a stored type when the attribute is an index into m_symbols
+    static constexpr std::uint8_t symbol_flag = 0x80;
+
+    static constexpr std::uint32_t no_id = std::numeric_limits<std::uint32_t>::max();
+
+    struct symbol_entry {
+        const char* data;
+        std::uint32_t size;
+
+        // interned id, or no_id
+        std::uint32_t id;
+    };
+
+    // index in the pool of the symbol of the first token with one at or after index
+    std::size_t symbol_index(std::size_t index) const;
+
+    // copy the owned symbols into a new arena, freeing the garbage
+    void compact();
+
+    void push(token_type type, std::uint32_t offset, std::uint32_t value) {
+        m_types.push_back(static_cast<std::uint8_t>(type));
+        m_offsets.push_back(offset);
+        m_values.push_back(value);
+    }
+
+    std::vector<std::uint8_t>  m_types;
+    std::vector<std::uint32_t> m_offsets;
+
+    // a number, or an index into m_symbols
+    std::vector<std::uint32_t> m_values;
+
+    // in the order of the tokens they belong to
+    std::vector<symbol_entry> m_symbols;
+
+    // symbols the stream owns
+    string_arena m_arena;
+
+    // bytes in the arena whose tokens were spliced out
+    std::size_t m_garbage = 0;
+};
+
+inline token_stream::const_iterator token_stream::begin() const {
+    return { this, 0 };
+}
+
+inline token_stream::const_iterator token_stream::end() const {
+    return { this, size() };
+}
+
+}
+
+#endif //MIPS_ASM_TOKEN_STREAM_HPP
@@ -0,0 +1,62 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#ifndef MIPS_ASM_DIRECTIVES_HPP
+#define MIPS_ASM_DIRECTIVES_HPP
+
+#include <array>
+#include <optional>
+#include <string_view>
+#include "perfect_hash.hpp"
+
+namespace as::spec {
+    /**
+     * The assembler directives that are recognised
+     */
+    enum class directive {
+        TEXT,   // .text - following statements are code
+        DATA,   // .data - following statements are data
+        WORD,   // .word  - 32-bit values
+        HALF,   // .half  - 16-bit values
+        BYTE,   // .byte  - 8-bit values
+        ASCII,  // .ascii  - a string
+        ASCIIZ, // .asciiz - a null terminated string
+        SPACE,  // .space - reserve bytes
+        ALIGN,  // .align - align to a power of two
+        GLOBL   // .globl - export a label
+    };
+
+    // Directive names without the dot, indexed by directive
+    inline constexpr std::array<std::string_view, 10> directives = {
+        "text",
+        "data",
+        "word",
+        "half",
+        "byte",
+        "ascii",
+        "asciiz",
+        "space",
+        "align",
+        "globl"
+    };
+
+    inline constexpr perfect_hash<directives.size()> directive_hash(directives);
+
+    /**
+     * Get a directive from its name
+     * @param name i.e. "text", without the .
+     * @return The directive, or nullopt if it isn't one
+     */
+    constexpr std::optional<directive> find_directive(std::string_view name) {
+        auto id = directive_hash.find(name);
+
+        if(id.has_value()) {
+            return static_cast<directive>(id.value());
+        }
+
+        return std::nullopt;
+    }
+}
+
+#endif //MIPS_ASM_DIRECTIVES_HPP
@@ -6,9 +6,10 @@
 #define MIPS_ASM_INSTRUCTION_HPP
 
 #include <cstddef>
+#include <cstdint>
 #include <list>
-#include <iostream>
-#include <bitset>
+#include <optional>
+#include <string_view>
 #include "../lexer/token_type.hpp"
 
 namespace as::spec {
@@ -73,10 +74,17 @@ public:
      *                          for R format, the opcode is stored here,
      *                          more commonly known as the funct value/function type for ALU
      */
-    instruction_def(const instruction_def_format& idf,
+    constexpr instruction_def(const instruction_def_format& idf,
             const operand_def_format& odf,
             const std::uint8_t& upper_field,
-            const std::uint8_t& lower_field);
+            const std::uint8_t& lower_field) :
+        m_ins_format(idf),
+        m_operand_fmt(odf),
+        m_upper_field(upper_field),
+        m_lower_field(lower_field)
+    {
+
+    }
 
     /**
      * Define an instruction by it's encoding, operands & upper field
@@ -86,33 +94,38 @@ public:
      *                          for I format this is opcode,
      *                          for R format this is SPECIAL / see R3000 spec for clarification
      */
-    instruction_def(const instruction_def_format& idf,
+    constexpr instruction_def(const instruction_def_format& idf,
             const operand_def_format& odf,
-            const std::uint8_t& upper_field);
+            const std::uint8_t& upper_field) :
+        m_ins_format(idf),
+        m_operand_fmt(odf),
+        m_upper_field(upper_field)
+    {
+
+    }
 
     /**
      * Get instruction encoding format
      * @return instruction format
      */
-    const instruction_def_format&   instruction_format();
+    const instruction_def_format&   instruction_format() const;
 
     /**
      * Get operand format
      * @return operand format
      */
-    const operand_def_format&       operand_format();
+    const operand_def_format&       operand_format() const;
 
 
     /**
      * Get the upper and lower fields as they would appear in an instruction
      * @return 32bit val
      */
-    std::uint32_t encoded() {
+    std::uint32_t encoded() const {
         std::uint32_t result = 0;
         result |= m_upper_field;
         result <<= (31-5);
         result |= m_lower_field;
-        std::cout << std::bitset<32>(result).to_string() << std::endl;
         return result;
     }
 private:
@@ -125,6 +138,7 @@ private:
 
 /**
  * Static container class for all possible instruction definitions
+ * Each instruction has a dense id, mnemonics are looked up with a perfect hash built at compile time
  */
 class instructions {
 public:
@@ -133,24 +147,40 @@ public:
      * @param mnemonic
      * @return True if mnemonic exists, else false
      */
-    static bool exists(const std::string& mnemonic) {
-        return instruction_defs.count(mnemonic) > 0;
+    static bool exists(std::string_view mnemonic) {
+        return id(mnemonic).has_value();
     }
 
+    /**
+     * Get the id of an instruction
+     * @param mnemonic
+     * @return The id, below count(), or nullopt if it isn't an instruction
+     */
+    static std::optional<std::uint8_t> id(std::string_view mnemonic);
+
     /**
      * Get instruction definition for instruction of mnemonic
      * @param mnemonic
-     * @return Optional of instruction definition
+     * @return The definition, or nullptr if it isn't an instruction
      */
-    static std::optional<instruction_def> get(const std::string& mnemonic) {
-        if(exists(mnemonic)) {
-            return instruction_defs.at(mnemonic);
-        }
+    static const instruction_def* find(std::string_view mnemonic);
 
-        return std::nullopt;
-    }
-private:
-    static const std::unordered_map<std::string, instruction_def> instruction_defs;
+    /**
+     * @param id An id from id()
+     * @return The instruction's definition
+     */
+    static const instruction_def& at(std::uint8_t id);
+
+    /**
+     * @param id An id from id()
+     * @return The instruction's mnemonic
+     */
+    static std::string_view mnemonic(std::uint8_t id);
+
+    /**
+     * @return The number of instructions
+     */
+    static std::size_t count();
 };
 
 }
@@ -0,0 +1,116 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#ifndef MIPS_ASM_PERFECT_HASH_HPP
+#define MIPS_ASM_PERFECT_HASH_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+
+namespace as::spec {
+
+/**
+ * A perfect hash over a fixed set of keys, built at compile time
+ * Every key hashes to its own slot, so a lookup is one hash, one table load and one compare,
+ * the result is the key's index in the array the hash was built from
+ *
+ *  constexpr std::array<std::string_view, 3> names = { "zero", "at", "v0" };
+ *  constexpr perfect_hash<3> name_hash(names);
+ *  name_hash.find("at") == 1
+ */
+template <std::size_t N>
+class perfect_hash {
+    static_assert(N > 0 && N < 255, "slots store a key index in a byte");
+
+public:
+    // at least 4 slots per key keeps the seed search short
+    static constexpr std::size_t table_size = [] {
+        std::size_t size = 1;
+
+        while(size < N * 4) {
+            size <<= 1;
+        }
+
+        return size;
+    }();
+
+    /**
+     * Search for a seed that hashes every key to a different slot
+     * @param keys The keys, they must be unique
+     */
+    constexpr explicit perfect_hash(const std::array<std::string_view, N>& keys) :
+        m_keys(keys)
+    {
+        for(std::uint32_t seed = 1; seed < (1u << 20); ++seed) {
+            if(try_seed(seed)) {
+                m_seed = seed;
+                return;
+            }
+        }
+
+        throw std::logic_error("no perfect hash seed found, are the keys unique?");
+    }
+
+    /**
+     * @return Index of the key, or nullopt if it isn't one of the keys
+     */
+    constexpr std::optional<std::size_t> find(std::string_view key) const {
+        auto slot = m_slots[hash(key, m_seed) & (table_size - 1)];
+
+        if(slot == 0 || m_keys[slot - 1] != key) {
+            return std::nullopt;
+        }
+
+        return slot - 1;
+    }
+
+    constexpr const std::array<std::string_view, N>& keys() const {
+        return m_keys;
+    }
+
+private:
+    // FNV-1a, seeded
+    static constexpr std::uint32_t hash(std::string_view key, std::uint32_t seed) {
+        std::uint32_t h = 2166136261u ^ seed;
+
+        for(char ch : key) {
+            h ^= static_cast<unsigned char>(ch);
+            h *= 16777619u;
+        }
+
+        return h ^ (h >> 15);
+    }
+
+    constexpr bool try_seed(std::uint32_t seed) {
+        for(auto& slot : m_slots) {
+            slot = 0;
+        }
+
+        for(std::size_t i = 0; i < N; ++i) {
+            auto& slot = m_slots[hash(m_keys[i], seed) & (table_size - 1)];
+
+            if(slot != 0) {
+                return false;
+            }
+
+            slot = static_cast<std::uint8_t>(i + 1);
+        }
+
+        return true;
+    }
+
+    std::array<std::string_view, N> m_keys;
+
+    // key index + 1, 0 for an empty slot
+    std::array<std::uint8_t, table_size> m_slots = { };
+    std::uint32_t m_seed = 0;
+};
+
+}
+
+#endif //MIPS_ASM_PERFECT_HASH_HPP
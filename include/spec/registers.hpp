@@ -5,44 +5,65 @@
 #ifndef MIPS_ASM_REGISTERS_HPP
 #define MIPS_ASM_REGISTERS_HPP
 
-#include <unordered_map>
-#include <string>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include "perfect_hash.hpp"
 
 namespace as::spec {
-    const std::unordered_map<std::string, std::uint8_t> registers = {
-        { "zero", 0 }, // Zero constant
-        { "at", 1 },   // Assembly temporary
-        { "v0", 2 },   // Function result
-        { "v1", 3 },   // and expression evaluations
-        { "a0", 4 },   // Arguments
-        { "a1", 5 },
-        { "a2", 6 },
-        { "a3", 7 },
-        { "t0", 8 },   // Temporaries
-        { "t1", 9 },
-        { "t2", 10 },
-        { "t3", 11 },
-        { "t4", 12 },
-        { "t5", 13 },
-        { "t6", 14 },
-        { "t7", 15 },
-        { "s0", 16 },  // Saved temporaries
-        { "s1", 17 },
-        { "s2", 18 },
-        { "s3", 19 },
-        { "s4", 20 },
-        { "s5", 21 },
-        { "s6", 22 },
-        { "s7", 23 },
-        { "t8", 24 },  // Temporaries
-        { "t9", 25 },
-        { "k0", 26 },  // Kernel
-        { "k1", 27 },
-        { "gp", 28 },  // Global pointer
-        { "sp", 29 },  // Stack pointer
-        { "fp", 30 },  // Frame pointer
-        { "ra", 31 }   // Return address
+    // Register names, indexed by register number
+    inline constexpr std::array<std::string_view, 32> registers = {
+        "zero", // Zero constant
+        "at",   // Assembly temporary
+        "v0",   // Function result
+        "v1",   // and expression evaluations
+        "a0",   // Arguments
+        "a1",
+        "a2",
+        "a3",
+        "t0",   // Temporaries
+        "t1",
+        "t2",
+        "t3",
+        "t4",
+        "t5",
+        "t6",
+        "t7",
+        "s0",   // Saved temporaries
+        "s1",
+        "s2",
+        "s3",
+        "s4",
+        "s5",
+        "s6",
+        "s7",
+        "t8",   // Temporaries
+        "t9",
+        "k0",   // Kernel
+        "k1",
+        "gp",   // Global pointer
+        "sp",   // Stack pointer
+        "fp",   // Frame pointer
+        "ra"    // Return address
     };
+
+    inline constexpr perfect_hash<registers.size()> register_hash(registers);
+
+    /**
+     * Get a register number from its name
+     * @param name i.e. "t0", without the $
+     * @return The register number, or nullopt if it isn't a register name
+     */
+    constexpr std::optional<std::uint8_t> find_register(std::string_view name) {
+        auto id = register_hash.find(name);
+
+        if(id.has_value()) {
+            return static_cast<std::uint8_t>(id.value());
+        }
+
+        return std::nullopt;
+    }
 }
 
 #endif //MIPS_ASM_REGISTERS_HPP
@@ -5,19 +5,22 @@
 #include "emitter/emitter.hpp"
 #include "emitter/encode.hpp"
 
-#include <iostream>
 #include <algorithm>
-#include <numeric>
-#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include "lexer/interner.hpp"
+#include "spec/directives.hpp"
 
 #include <elf.h>
 
 namespace as {
 
-std::optional<std::vector<std::uint8_t>>
-emit(const std::vector<as::token> &tokens) {
+namespace {
 
-    constexpr std::uint32_t SECTION_TEXT_BASE = 0x00000000004000f0;
+constexpr std::uint32_t SECTION_TEXT_BASE = 0x00000000004000f0;
 
 //    Elf32_Ehdr elf_header = {
 //        .e_ident = {ELFMAG0, ELFMAG1, ELFMAG2, ELFMAG3, ELFCLASS32, ELFDATA2MSB, EV_CURRENT, ELFOSABI_SYSV, 0,
@@ -34,71 +37,754 @@ emit(const std::vector<as::token> &tokens) {
 //
 //    };
 
-    enum assembly_mode {
-        TEXT,
-        DATA
-    };
+enum assembly_mode {
+    TEXT,
+    DATA
+};
 
-    enum assembly_pass {
-        PASS_ONE,   // we use this pass to determine where to place code blocks, all labels in this default to 0
-        PASS_TWO    // the second pass rewrites the labels to point to where we placed the previous code blocks
-    };
+/**
+ * Where a label was defined, and where it was first used
+ */
+struct label {
+    assembly_mode section = TEXT;
+    std::uint32_t offset = 0; // from the start of its section
+    bool defined = false;
+
+    std::uint32_t first_use = 0; // source offset, to report it if it's never defined
+    bool used = false;
+};
+
+/**
+ * A label operand whose address wasn't known when its word was written, it was written as 0
+ * and the address is ORed in once every label has been placed, rather than assembling everything twice
+ */
+struct fixup {
+    assembly_mode section;
+    std::uint32_t at;           // offset of the word in its section, a branch is relative to it
+    std::uint32_t label;
+    const encoded_field* field; // where the address goes in the word
+    std::uint32_t source;       // offset of the operand, to report it if the address doesn't fit
+};
+
+/**
+ * An instruction that was laid out but not encoded yet, see emit_parallel
+ */
+struct deferred_instruction {
+    std::uint32_t begin;  // its tokens, [begin, end)
+    std::uint32_t end;
+    std::uint32_t at;     // offset of its first word in .text
+    std::uint32_t label;  // the label it refers to, or no_label
+
+    // the label token encoding asked the address of, or no_label, only then is the label used
+    std::uint32_t used;
+};
+
+constexpr std::uint32_t no_label = 0xFFFFFFFF;
+
+// .word <label> is the whole address
+constexpr encoded_field word_field = { 0, field_source::LABEL, range_check::NONE, 0, 0, 0, 0xFFFFFFFF };
+
+// Append a value, MIPS is big endian
+void put(std::vector<std::uint8_t>& section, std::uint32_t value, std::size_t bytes) {
+    for(std::size_t i = bytes; i-- > 0; ) {
+        section.push_back(static_cast<std::uint8_t>(value >> (i * 8)));
+    }
+}
+
+// Overwrite a word that was already written
+void write(std::vector<std::uint8_t>& section, std::size_t at, std::uint32_t value) {
+    for(std::size_t i = 0; i < 4; ++i) {
+        section[at + i] = static_cast<std::uint8_t>(value >> ((3 - i) * 8));
+    }
+}
+
+// OR bits into a word that was already written
+void patch(std::vector<std::uint8_t>& section, std::size_t at, std::uint32_t bits) {
+    for(std::size_t i = 0; i < 4; ++i) {
+        section[at + i] |= static_cast<std::uint8_t>(bits >> ((3 - i) * 8));
+    }
+}
+
+// The character an escape sequence stands for, i.e. a newline for \n
+char unescape(char c) {
+    switch(c) {
+        case 'n': return '\n';
+        case 't': return '\t';
+        case 'r': return '\r';
+        case '0': return '\0';
+        default:  return c;
+    }
+}
+
+// Append the characters of a string or character literal, escape sequences are replaced
+void put_literal(std::vector<std::uint8_t>& section, std::string_view literal) {
+    for(std::size_t i = 0; i < literal.size(); ++i) {
+        char c = literal[i];
+
+        if(c == '\\' && i + 1 < literal.size()) {
+            c = unescape(literal[++i]);
+        }
+
+        section.push_back(static_cast<std::uint8_t>(c));
+    }
+}
+
+/**
+ * What is carried from one statement to the next while assembling
+ * Statements are assembled once, in order. A label used before it is defined, or defined in .data
+ * whose address isn't known until the size of .text is, is written as 0 and recorded as a fixup
+ * If instructions are deferred, each is only given its word in .text, they're encoded once every label is placed
+ */
+struct assembly {
+    explicit assembly(diagnostic_sink* diagnostics) :
+        sink(diagnostics)
+    {
+
+    }
 
     assembly_mode mode = TEXT;
-    assembly_pass pass = PASS_ONE;
 
-    std::unordered_map<std::string, std::uint32_t> labels;
-    std::vector<token> token_buffer;
+    std::vector<std::uint8_t> text;
+    std::vector<std::uint8_t> data;
 
-    for(auto& tk : tokens) {
+    // label names are interned here rather than borrowed from the tokens, a statement's tokens may not outlive it
+    interner names;
 
-//        // if directive encountered
-//        if(tk.type() == token_type::DIRECTIVE) {
-//            auto& directive = std::get<std::string>(tk.attribute());
-//
-//            // swap to respective modes
-//            if(directive == "text") {
-//                mode = TEXT;
-//                break;
-//            }
-//
-//            if(directive == "data") {
-//                mode = DATA;
-//                break;
-//            }
-//
-//            continue;
-//        }
+    // the id in names of each symbol id the lexer interned, or no_label if it hasn't been seen yet,
+    // so a label's name is only looked up the first time its symbol is
+    std::vector<std::uint32_t> symbol_labels;
+
+    // indexed by the id of the label's name
+    std::vector<label> labels;
+    std::vector<fixup> fixups;
+
+    // labels defined by the statement being assembled, they're placed once it's aligned. id and source offset
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> pending;
+
+    // the label the instruction being encoded refers to
+    std::uint32_t referenced = 0;
+
+    // if set, instructions are laid out here rather than encoded as they're reached
+    bool defer = false;
+    std::vector<deferred_instruction> deferred;
+
+    // where .data starts, set by close_text()
+    std::uint32_t data_base = 0;
+
+    diagnostic_sink* sink;
+    bool failed = false;
+
+    template <typename Message>
+    void error(std::uint32_t offset, Message&& message) {
+        failed = true;
+
+        if(sink != nullptr) {
+            sink->report(severity::ERROR, offset, message);
+        }
+    }
+
+    template <typename Message>
+    void warning(std::uint32_t offset, Message&& message) {
+        if(sink != nullptr) {
+            sink->report(severity::WARNING, offset, message);
+        }
+    }
+
+    std::vector<std::uint8_t>& section() {
+        return mode == TEXT ? text : data;
+    }
+
+    // Pad the current section with zeroes to a multiple of alignment
+    void align(std::size_t alignment) {
+        auto& bytes = section();
+        bytes.resize((bytes.size() + alignment - 1) / alignment * alignment, 0);
+    }
+
+    /**
+     * The id of the label a token names, by the symbol id it was interned with while lexing if it was,
+     * otherwise by its name. Tokens of the same name are the same label either way
+     */
+    std::uint32_t label_id(const token_stream& tokens, std::size_t index) {
+        auto symbol = tokens.symbol_id(index);
+
+        if(!symbol.has_value()) {
+            return intern_label(tokens.symbol(index));
+        }
+
+        if(symbol.value() >= symbol_labels.size()) {
+            symbol_labels.resize(symbol.value() + 1, no_label);
+        }
+
+        auto& id = symbol_labels[symbol.value()];
+
+        if(id == no_label) {
+            id = intern_label(tokens.symbol(index));
+        }
+
+        return id;
+    }
+
+    std::uint32_t intern_label(std::string_view name) {
+        auto id = names.intern(name);
+
+        if(id >= labels.size()) {
+            labels.resize(id + 1);
+        }
+
+        return id;
+    }
+
+    // Place the labels of the statement being assembled where the current section is
+    void place_labels() {
+        for(auto& [id, offset] : pending) {
+            auto& defined = labels[id];
+
+            if(defined.defined) {
+                warning(offset, [this, id = id] {
+                    return "Label " + std::string(names.name(id)) + " redefined, the new label will be used instead";
+                });
+            }
+
+            defined.section = mode;
+            defined.offset  = static_cast<std::uint32_t>(section().size());
+            defined.defined = true;
+        }
+
+        pending.clear();
+    }
+
+    // Note the use of the label token at an index, deferred instructions note theirs after the statements after them
+    std::uint32_t use_label(const token_stream& tokens, std::size_t index) {
+        auto id = label_id(tokens, index);
+        auto& used = labels[id];
+
+        if(!used.used || tokens.offset(index) < used.first_use) {
+            used.used = true;
+            used.first_use = tokens.offset(index);
+        }
+
+        return id;
+    }
+
+    // The address of a label, if it's known yet
+    std::optional<std::uint32_t> known_address(std::uint32_t id) const {
+        auto& known = labels[id];
+
+        if(known.defined && known.section == TEXT) {
+            return SECTION_TEXT_BASE + known.offset;
+        }
+
+        return std::nullopt;
+    }
+
+    // The address of a label once .text is closed
+    std::optional<std::uint32_t> address(std::uint32_t id) const {
+        if(id == no_label || !labels[id].defined) {
+            return std::nullopt;
+        }
+
+        return (labels[id].section == TEXT ? SECTION_TEXT_BASE : data_base) + labels[id].offset;
+    }
+
+    /**
+     * Assemble a statement
+     * @param tokens Stream the statement is in
+     * @param begin  Index of its first token
+     * @param end    Index of the NEW_LINE ending it
+     */
+    void statement(const token_stream& tokens, std::size_t begin, std::size_t end) {
+        std::size_t i = begin;
+
+        for(; i < end && tokens.type(i) == token_type::LABEL_DEFINITION; ++i) {
+            pending.emplace_back(label_id(tokens, i), tokens.offset(i));
+        }
+
+        if(i == end) {
+            place_labels();
+            return;
+        }
+
+        switch(tokens.type(i)) {
+            case token_type::DIRECTIVE:
+                directive(tokens, i, end);
+            break;
+
+            case token_type::MNEMONIC:
+                instruction(tokens, i, end);
+            break;
+
+            // the lexer has reported it
+            case token_type::INVALID_TOKEN:
+                failed = true;
+                place_labels();
+            break;
+
+            default:
+                error(tokens.offset(i), [] { return std::string("Expected an instruction or directive"); });
+                place_labels();
+            break;
+        }
+    }
+
+    void instruction(const token_stream& tokens, std::size_t begin, std::size_t end) {
+        if(mode != TEXT) {
+            error(tokens.offset(begin), [] { return std::string("Instructions must be in the .text section"); });
+            place_labels();
+            return;
+        }
+
+        align(4);
+        place_labels();
+
+        auto at = static_cast<std::uint32_t>(text.size());
+
+        if(defer) {
+            std::uint32_t label = no_label;
+
+            // it's only used once the statement is known to encode, see use_deferred_labels
+            for(std::size_t i = begin; i < end; ++i) {
+                if(tokens.type(i) == token_type::LABEL) {
+                    label = label_id(tokens, i);
+                    break;
+                }
+            }
+
+            deferred.push_back({ static_cast<std::uint32_t>(begin), static_cast<std::uint32_t>(end), at, label,
+                                 no_label });
+
+            // only an instruction with a label can be a pseudo-instruction
+            auto words = label != no_label ? statement_words(tokens, begin, end) : 1;
+
+            for(std::size_t word = 0; word < words; ++word) {
+                put(text, 0, 4);
+            }
+            return;
+        }
+
+        const encoding_plan* unresolved = nullptr;
+
+        auto ins = encode_statement(tokens, begin, end, SECTION_TEXT_BASE + at, [this, &tokens](std::size_t i) {
+            referenced = use_label(tokens, i);
+            return known_address(referenced);
+        }, unresolved, sink);
+
+        if(!ins.has_value()) {
+            failed = true;
+
+            // its words are kept for an instruction that failed, so the addresses after it are still right
+            for(std::size_t word = 0; word < statement_words(tokens, begin, end); ++word) {
+                put(text, 0, 4);
+            }
+            return;
+        }
+
+        if(unresolved != nullptr) {
+            for(auto& field : *unresolved) {
+                if(field.is_label()) {
+                    fixups.push_back({ TEXT, at + 4 * field.word, referenced, &field, tokens.offset(begin + field.token) });
+                }
+            }
+        }
+
+        for(auto word : ins.value()) {
+            put(text, word, 4);
+        }
+    }
+
+    /**
+     * Call operand with the index of each operand of a directive, they're separated by commas
+     * @return false if there are none, or they weren't
+     */
+    template <typename Operand>
+    bool operands(const token_stream& tokens, std::size_t begin, std::size_t end, Operand&& operand) {
+        if(end == begin + 1) {
+            error(tokens.offset(begin), [] { return std::string("Expected at least one operand"); });
+            return false;
+        }
 
-        // keep fetching tokens until we encounter the end of a sequence
-        if(tk.type() != token_type::NEW_LINE) {
-            token_buffer.emplace_back(tk);
+        if(end > begin + 1 && tokens.type(end - 1) == token_type::COMMA) {
+            error(tokens.offset(end - 1), [] { return std::string("Expected an operand after the comma"); });
+            return false;
         }
-        else { // if we encountered the end of a sequence of tokens (delimited by new lines)
-            switch(mode) {
-                case TEXT:
 
+        for(std::size_t i = begin + 1; i < end; i += 2) {
+            if(tokens.type(i) == token_type::COMMA || (i + 1 < end && tokens.type(i + 1) != token_type::COMMA)) {
+                error(tokens.offset(i), [] { return std::string("Expected operands separated by commas"); });
+                return false;
+            }
 
+            operand(i);
+        }
+
+        return true;
+    }
+
+    // The only operand of a directive, which is a number
+    std::optional<std::int32_t> number_operand(const token_stream& tokens, std::size_t begin, std::size_t end) {
+        if(end - begin != 2 || tokens.type(begin + 1) != token_type::LITERAL_NUMBER) {
+            error(tokens.offset(begin), [] { return std::string("Expected a number"); });
+            return std::nullopt;
+        }
+
+        return tokens.number(begin + 1);
+    }
 
+    // .word, .half and .byte
+    void values(const token_stream& tokens, std::size_t begin, std::size_t end, std::size_t bytes) {
+        align(bytes);
+        place_labels();
+
+        auto& out = section();
+
+        operands(tokens, begin, end, [&](std::size_t i) {
+            std::int64_t value = 0;
+
+            switch(tokens.type(i)) {
+                case token_type::LITERAL_NUMBER:
+                    value = tokens.number(i);
                 break;
 
-                case DATA:
+                case token_type::LITERAL_CHAR: {
+                    auto literal = tokens.symbol(i);
+                    char c = literal.empty() ? '\0' : literal[0];
+
+                    if(c == '\\' && literal.size() > 1) {
+                        c = unescape(literal[1]);
+                    }
+
+                    value = static_cast<unsigned char>(c);
+                }
                 break;
+
+                case token_type::LABEL:
+                    if(bytes == 4) {
+                        auto id = use_label(tokens, i);
+                        auto address = known_address(id);
+
+                        if(!address.has_value()) {
+                            fixups.push_back({ mode, static_cast<std::uint32_t>(out.size()), id, &word_field,
+                                               tokens.offset(i) });
+                        }
+
+                        value = address.value_or(0);
+                        break;
+                    }
+                    [[fallthrough]];
+
+                default:
+                    error(tokens.offset(i), [] { return std::string("Expected a number"); });
+                break;
+            }
+
+            auto bits = bytes * 8;
+
+            if(bits < 32 && (value < -(std::int64_t(1) << (bits - 1)) || value >= (std::int64_t(1) << bits))) {
+                warning(tokens.offset(i), [] { return std::string("Value out of range, only its low bits are kept"); });
+            }
+
+            put(out, static_cast<std::uint32_t>(value), bytes);
+        });
+    }
+
+    // .ascii and .asciiz
+    void strings(const token_stream& tokens, std::size_t begin, std::size_t end, bool terminated) {
+        place_labels();
+
+        auto& out = section();
+
+        operands(tokens, begin, end, [&](std::size_t i) {
+            if(tokens.type(i) != token_type::LITERAL_STRING) {
+                error(tokens.offset(i), [] { return std::string("Expected a string"); });
+                return;
+            }
+
+            put_literal(out, tokens.symbol(i));
+
+            if(terminated) {
+                out.push_back(0);
+            }
+        });
+    }
+
+    void directive(const token_stream& tokens, std::size_t begin, std::size_t end) {
+        auto name = tokens.symbol(begin);
+        auto found = spec::find_directive(name);
+
+        if(!found.has_value()) {
+            error(tokens.offset(begin), [name] { return "Unknown directive ." + std::string(name); });
+            place_labels();
+            return;
+        }
+
+        switch(found.value()) {
+            case spec::directive::TEXT:
+                mode = TEXT;
+                place_labels();
+            break;
+
+            case spec::directive::DATA:
+                mode = DATA;
+                place_labels();
+            break;
+
+            case spec::directive::WORD:   values(tokens, begin, end, 4); break;
+            case spec::directive::HALF:   values(tokens, begin, end, 2); break;
+            case spec::directive::BYTE:   values(tokens, begin, end, 1); break;
+            case spec::directive::ASCII:  strings(tokens, begin, end, false); break;
+            case spec::directive::ASCIIZ: strings(tokens, begin, end, true); break;
+
+            case spec::directive::SPACE: {
+                place_labels();
+                auto size = number_operand(tokens, begin, end);
+
+                if(size.has_value() && size.value() < 0) {
+                    error(tokens.offset(begin + 1), [] { return std::string("Space size can't be negative"); });
+                }
+                else if(size.has_value()) {
+                    section().resize(section().size() + size.value(), 0);
+                }
             }
+            break;
+
+            case spec::directive::ALIGN: {
+                auto power = number_operand(tokens, begin, end);
+
+                if(power.has_value() && (power.value() < 0 || power.value() > 16)) {
+                    error(tokens.offset(begin + 1), [] { return std::string("Alignment must be between 0 and 16"); });
+                }
+                else if(power.has_value()) {
+                    align(std::size_t(1) << power.value());
+                }
+
+                place_labels();
+            }
+            break;
+
+            // every label is visible in a flat binary
+            case spec::directive::GLOBL:
+                place_labels();
+            break;
         }
+    }
+
+    // Place .data after .text, every label's address is then known
+    void close_text() {
+        // the data follows the text, word aligned
+        mode = TEXT;
+        align(4);
 
+        data_base = SECTION_TEXT_BASE + static_cast<std::uint32_t>(text.size());
     }
 
-    return std::nullopt;
+    /**
+     * Encode deferred instructions [first, last), every label must have been placed
+     * Each writes its own words of .text, so ranges can be encoded concurrently
+     * @param diagnostics Where the diagnostics of the range are reported
+     * @return false if any failed
+     */
+    bool encode_deferred(const token_stream& tokens, std::size_t first, std::size_t last,
+                         diagnostic_sink* diagnostics) {
+        bool encoded = true;
+
+        for(std::size_t i = first; i < last; ++i) {
+            auto& ins = deferred[i];
+            const encoding_plan* unresolved = nullptr;
+
+            // an undefined label is encoded as 0, it is reported by finish()
+            auto words = encode_statement(tokens, ins.begin, ins.end, SECTION_TEXT_BASE + ins.at,
+                                          [this, &ins](std::size_t index) {
+                ins.used = static_cast<std::uint32_t>(index);
+                return address(ins.label);
+            }, unresolved, diagnostics);
+
+            if(!words.has_value()) {
+                encoded = false;
+                continue;
+            }
+
+            // the vector isn't resized, so writing distinct words from several threads is safe
+            std::uint32_t at = ins.at;
+
+            for(auto word : words.value()) {
+                write(text, at, word);
+                at += 4;
+            }
+        }
+
+        return encoded;
+    }
+
+    /**
+     * Note the labels deferred instructions used once they're encoded, as emit() does when it encodes them,
+     * a statement that doesn't match an instruction doesn't use its label
+     */
+    void use_deferred_labels(const token_stream& tokens) {
+        for(auto& ins : deferred) {
+            if(ins.used != no_label) {
+                use_label(tokens, ins.used);
+            }
+        }
+    }
+
+    /**
+     * Place .data after .text, patch in the addresses of the fixups and join the sections
+     * @return The sections, or nullopt if there were errors
+     */
+    std::optional<std::vector<std::uint8_t>> finish() {
+        close_text();
+
+        for(std::uint32_t id = 0; id < labels.size(); ++id) {
+            if(labels[id].used && !labels[id].defined) {
+                error(labels[id].first_use, [this, id] { return "Undefined label " + std::string(names.name(id)); });
+            }
+        }
+
+        for(auto& fix : fixups) {
+            auto& target = labels[fix.label];
+
+            if(!target.defined) {
+                continue;
+            }
+
+            std::uint32_t address = (target.section == TEXT ? SECTION_TEXT_BASE : data_base) + target.offset;
+            std::uint32_t pc = (fix.section == TEXT ? SECTION_TEXT_BASE : data_base) + fix.at;
+            auto& field = *fix.field;
+            auto value = field.label_value(address, pc);
+
+            if(field.check != range_check::NONE && !field.fits(value)) {
+                error(fix.source, [] { return std::string(branch_out_of_range); });
+                continue;
+            }
+
+            patch(fix.section == TEXT ? text : data, fix.at, field.bits(value));
+        }
+
+        if(failed) {
+            return std::nullopt;
+        }
+
+        text.insert(text.end(), data.begin(), data.end());
+        return std::move(text);
+    }
+};
+
 }
 
-/**
- *     if(m_text_labels.count(label)) {
-        std::cout << "warning: label redefinition, the new label will be used instead ("
-                  << label
-                  << ") "
-                  << std::endl;
+std::optional<std::vector<std::uint8_t>>
+emit(const token_stream &tokens, diagnostic_sink* sink) {
+    assembly state(sink);
+
+    // each sequence of tokens is delimited by new lines,
+    // only the token types are scanned to find them
+    for(std::size_t begin = 0; begin < tokens.size(); ) {
+        auto end = tokens.find(token_type::NEW_LINE, begin);
+
+        state.statement(tokens, begin, end);
+
+        begin = end + 1;
     }
 
- */
-}
\ No newline at end of file
+    return state.finish();
+}
+
+std::optional<std::vector<std::uint8_t>>
+emit_parallel(const token_stream& tokens, unsigned threads, diagnostic_sink* sink) {
+    // below this, a thread isn't worth starting
+    constexpr std::size_t min_chunk_size = 4096;
+
+    if(threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // an instruction is at least a mnemonic and its NEW_LINE, so with fewer tokens than this there'd be one chunk
+    // on one thread laying out then encoding is only slower than emit, which does both in one pass
+    if(threads == 1 || tokens.size() < 2 * 2 * min_chunk_size) {
+        return emit(tokens, sink);
+    }
+
+    // the chunks report into lists that are merged in source order, the sink isn't synchronised
+    std::optional<severity> least;
+
+    for(auto level : { severity::TRACE, severity::NOTE, severity::WARNING, severity::ERROR }) {
+        if(sink != nullptr && !least.has_value() && sink->wants(level)) {
+            least = level;
+        }
+    }
+
+    diagnostic_list layout_diagnostics(least.value_or(severity::ERROR));
+
+    assembly state(sink != nullptr ? &layout_diagnostics : nullptr);
+    state.defer = true;
+
+    // lay out every statement, so every label is placed
+    for(std::size_t begin = 0; begin < tokens.size(); ) {
+        auto end = tokens.find(token_type::NEW_LINE, begin);
+
+        state.statement(tokens, begin, end);
+
+        begin = end + 1;
+    }
+
+    state.close_text();
+
+    // encode chunks of about the same number of instructions at once, this thread takes the first
+    auto& deferred = state.deferred;
+    std::size_t chunk_count = std::max<std::size_t>(1, std::min<std::size_t>(threads, deferred.size() / min_chunk_size));
+
+    std::vector<diagnostic_list> chunk_diagnostics(chunk_count, diagnostic_list(least.value_or(severity::ERROR)));
+    std::vector<char> encoded(chunk_count, true);
+    std::vector<std::thread> workers;
+
+    auto encode_chunk = [&](std::size_t i) {
+        encoded[i] = state.encode_deferred(tokens,
+                                           deferred.size() * i / chunk_count,
+                                           deferred.size() * (i + 1) / chunk_count,
+                                           sink != nullptr ? &chunk_diagnostics[i] : nullptr);
+    };
+
+    for(std::size_t i = 1; i < chunk_count; ++i) {
+        workers.emplace_back(encode_chunk, i);
+    }
+
+    encode_chunk(0);
+
+    for(auto& worker : workers) {
+        worker.join();
+    }
+
+    state.failed |= std::find(encoded.begin(), encoded.end(), false) != encoded.end();
+    state.use_deferred_labels(tokens);
+
+    auto binary = state.finish();
+
+    if(sink != nullptr) {
+        std::vector<diagnostic> merged = layout_diagnostics.diagnostics();
+
+        for(auto& chunk : chunk_diagnostics) {
+            merged.insert(merged.end(), chunk.diagnostics().begin(), chunk.diagnostics().end());
+        }
+
+        std::stable_sort(merged.begin(), merged.end(), [](const diagnostic& a, const diagnostic& b) {
+            return a.offset < b.offset;
+        });
+
+        for(auto& reported : merged) {
+            sink->report(std::move(reported));
+        }
+    }
+
+    return binary;
+}
+
+std::optional<std::vector<std::uint8_t>>
+emit(generator<token_stream> statements, diagnostic_sink* sink) {
+    assembly state(sink);
+
+    for(auto& statement : statements) {
+        state.statement(statement, 0, statement.size() - 1);
+    }
+
+    return state.finish();
+}
+
+}
@@ -2,193 +2,243 @@
 // Created by ocanty on 21/03/19.
 //
 
-#include <numeric>
-#include <algorithm>
+#include <bitset>
 #include <string>
-#include <sstream>
-#include <utility>
 #include <optional>
 #include "emitter/encode.hpp"
+#include "emitter/encoding_plan.hpp"
 
 namespace as {
 
-std::optional<std::uint32_t>
-encode_instruction(const std::vector<token> &tokens,
-                   const std::unordered_map<std::string, std::uint32_t>& labels) {
+namespace {
+
+// A statement held as token objects
+struct vector_statement {
+    const std::vector<token>& tokens;
+
+    std::size_t size() const                       { return tokens.size(); }
+    token_type type(std::size_t i) const           { return tokens[i].type(); }
+    std::uint32_t offset(std::size_t i) const      { return tokens[i].offset(); }
+    std::string_view symbol(std::size_t i) const   { return tokens[i].symbol(); }
+    std::int32_t number(std::size_t i) const       { return tokens[i].number(); }
+};
+
+// A statement read in place from a token_stream, the tokens [begin, end)
+struct stream_statement {
+    const token_stream& tokens;
+    std::size_t begin;
+    std::size_t end;
+
+    std::size_t size() const                       { return end - begin; }
+    token_type type(std::size_t i) const           { return tokens.type(begin + i); }
+    std::uint32_t offset(std::size_t i) const      { return tokens.offset(begin + i); }
+    std::string_view symbol(std::size_t i) const   { return tokens.symbol(begin + i); }
+    std::int32_t number(std::size_t i) const       { return tokens.number(begin + i); }
+};
+
+// The plan to encode a statement with, or nullptr if there isn't one, why is reported if sink is set
+template <typename Statement>
+const encoding_plan* plan_for(const Statement& tokens, diagnostic_sink* sink) {
+    auto report = [sink](std::uint32_t offset, auto&& message) {
+        if(sink != nullptr) {
+            sink->report(severity::ERROR, offset, message);
+        }
+    };
 
-    std::stringstream log;
+    if(tokens.size() == 0) {
+        report(0, [] {
+            return std::string("Tried to encode an instruction with an empty token buffer. This should never happen!");
+        });
+        return nullptr;
+    }
 
-    // check if the sequence of tokens match an operation
+    auto mnemonic_offset = tokens.offset(0);
 
-    // first get token_types for all the tokens passed
-    std::vector<token_type> token_types = std::accumulate(
-        tokens.begin(),
-        tokens.end(),
-        std::vector<token_type>{},
-        [](std::vector<token_type>& token_types, const token& token) {
-            token_types.emplace_back(token.type());
-            return token_types;
-        });
+    // check if the sequence of tokens match an operation,
+    // their types are packed into a signature that indexes the sequences our assembler supports
+    op_signature signature;
 
-    bool valid_sequence = false;
-    op_sequence sequence;
+    for(std::size_t i = 0; i < tokens.size(); ++i) {
+        signature.push(tokens.type(i));
+    }
 
-    // check against each possible operation sequence that our assembler supports
-    for(auto& seq : op_sequences::all()) {
-        if (token_types == seq.token_types()) {
-            sequence = seq;
-            valid_sequence = true;
-            break;
-        }
+    const op_sequence* matched = op_sequences::find(signature);
+
+    if(matched == nullptr) {
+        report(mnemonic_offset, [] {
+            return std::string("Unknown sequence of tokens");
+        });
+        return nullptr;
     }
 
-    if(!valid_sequence) {
-        log << "Unknown sequence of tokens ";
+    auto mnemonic_name = tokens.symbol(0);
 
-        if(tokens.size() > 0) {
-            log << "near line "
-                     << tokens.at(0).line()
-                     << " ";
-        }
+    // get the instruction definition for this mnemonic
+    auto instruction = spec::instructions::id(mnemonic_name);
 
-        log << std::endl;
-        return std::nullopt;
+    if(!instruction.has_value()) {
+        report(mnemonic_offset, [mnemonic_name] {
+            return "Invalid mnemonic " + std::string(mnemonic_name);
+        });
+        return nullptr;
     }
 
-    if(tokens.empty()) {
-        log << "Tried to encode an instruction with an empty token buffer. "
-            << "This should never happen!"
-            << std::endl;
-        return std::nullopt;
-    }
+    // check if the sequence supports the operand format of the instruction/mnemonic
+    auto plan = encoding_plan::find(instruction.value(), *matched);
 
-    auto& mnemonic_token = tokens.at(0);
+    if(plan == nullptr) {
+        report(mnemonic_offset, [mnemonic_name] {
+            return "Invalid operands for " + std::string(mnemonic_name);
+        });
+    }
 
-    try {
-        auto &mnemonic_name = std::get<std::string>(mnemonic_token.attribute());
+    return plan;
+}
 
-        // get the instruction definition for this mnemonic
-        auto instruction_def = spec::instructions::get(mnemonic_name);
+// Report an operand whose value failed its field's range_check
+template <typename Statement>
+void report_field(const Statement& tokens, const encoded_field& field, diagnostic_sink& sink) {
+    if(field.check == range_check::WARNING) {
+        sink.report(severity::WARNING, tokens.offset(field.token), [&field] {
+            return "Operand out of range, only its low bits are encoded (0 <= x <= "
+                   + std::to_string(field.mask) + ")";
+        });
+    }
+    else if(field.source == field_source::LABEL_RELATIVE) {
+        sink.report(severity::ERROR, tokens.offset(field.token), [] {
+            return std::string(branch_out_of_range);
+        });
+    }
+    else if(field.either_sign) {
+        sink.report(severity::ERROR, tokens.offset(field.token), [&field] {
+            return "Immediate out of range (-" + std::to_string((field.mask >> 1) + 1) + " <= x <= "
+                   + std::to_string(field.mask) + ")";
+        });
+    }
+    else {
+        sink.report(severity::ERROR, tokens.offset(0), [] {
+            return std::string("Invalid register ranges (e.g. $x, where 0 <= x <= 31) in instruction");
+        });
+    }
+}
 
-        // if there was a definition
-        if(instruction_def.has_value()) {
+template <typename Statement>
+void trace_words(const Statement& tokens, const encoded_words& words, diagnostic_sink& sink) {
+    sink.trace(tokens.offset(0), [&tokens, &words] {
+        std::string encoded = "Encoded " + std::string(tokens.symbol(0)) + " as";
 
-            auto& operand_fmt = instruction_def.value().operand_format();
+        for(auto word : words) {
+            encoded += " " + std::bitset<32>(word).to_string();
+        }
 
-            // check if the sequence supports the operand format of the instruction/mnemonic
-            if(sequence.supports_operand_format(operand_fmt)) {
+        return encoded;
+    });
+}
 
-                // instruction & sequence are both valid
-                // lets encode
+// Encodes an instruction at pc, label_address returns the address of the label token at an index of the statement,
+// or nullopt if it isn't defined. Its fields are then encoded as 0
+// Diagnostics are only built if sink wants them, see encode_statement in encode.hpp which is the same for a stream
+template <typename Statement, typename LabelAddress>
+std::optional<encoded_words> encode(const Statement& tokens, std::uint32_t pc, LabelAddress&& label_address,
+                                    diagnostic_sink* sink) {
+    auto plan = plan_for(tokens, sink);
 
-                // get positions of every possible operand
-                auto rs_position     = sequence.operand_position(operand_fmt, "rs");
-                auto rd_position     = sequence.operand_position(operand_fmt, "rd");
-                auto rt_position     = sequence.operand_position(operand_fmt, "rt");
-                auto imm_position    = sequence.operand_position(operand_fmt, "imm");
-                // auto offset_position = sequence.operand_position(operand_fmt, "off");
-                auto shamt_position  = sequence.operand_position(operand_fmt, "shamt");
-                auto label_position  = sequence.operand_position(operand_fmt, "label");
+    if(plan == nullptr) {
+        return std::nullopt;
+    }
 
-                auto rs = (rs_position.has_value() ?
-                    std::get<std::int32_t>(tokens.at(rs_position.value()).attribute()) : 0);
+    // instruction & sequence are both valid, the plan knows which token each operand is
+    auto ins = plan->encode(pc,
+        [&tokens](std::size_t i) { return tokens.number(i); },
+        label_address,
+        [&tokens, sink](const encoded_field& field) {
+            if(sink != nullptr) {
+                report_field(tokens, field, *sink);
+            }
+        });
 
-                auto rt = (rt_position.has_value() ?
-                    std::get<std::int32_t>(tokens.at(rt_position.value()).attribute()) : 0);
+    if(ins.has_value() && sink != nullptr) {
+        trace_words(tokens, ins.value(), *sink);
+    }
 
-                auto rd = (rd_position.has_value() ?
-                    std::get<std::int32_t>(tokens.at(rd_position.value()).attribute()) : 0);
+    return ins;
+}
 
-                auto imm = (imm_position.has_value() ?
-                    std::get<std::int32_t>(tokens.at(imm_position.value()).attribute()) : 0);
+// The only word of an instruction, a pseudo-instruction's words have to be placed by the emitter
+std::optional<std::uint32_t> single_word(const std::vector<token>& tokens, const std::optional<encoded_words>& ins,
+                                         diagnostic_sink* sink) {
+    if(!ins.has_value()) {
+        return std::nullopt;
+    }
 
-                auto shamt = (shamt_position.has_value() ?
-                    std::get<std::int32_t>(tokens.at(shamt_position.value()).attribute()) : 0);
+    if(ins.value().size != 1) {
+        if(sink != nullptr) {
+            sink->report(severity::ERROR, tokens.front().offset(), [&tokens] {
+                return std::string(tokens.front().symbol()) + " with a label is assembled as more than one instruction";
+            });
+        }
 
-                // labels
-                std::string label = "";
+        return std::nullopt;
+    }
 
-                if(label_position.has_value()) {
-                    label = std::get<std::string>(tokens.at(label_position.value()).attribute());
+    return ins.value().words[0];
+}
 
-                    if(label.size() && labels.count(label)) {
-                        imm = labels.at(label);
-                    }
-                }
+}
 
-                if(rs > 31 || rs < 0 || rt > 31 || rt < 0 || rd > 31 || rd < 0) {
-                    log << "Invalid register ranges (e.g. $x, where 0 <= x <= 31, in instruction near line "
-                        << mnemonic_token.line()
-                        << std::endl;
+std::optional<std::uint32_t>
+encode_instruction(const std::vector<token> &tokens,
+                   const std::unordered_map<std::string, std::uint32_t>& labels,
+                   diagnostic_sink* sink,
+                   std::uint32_t pc) {
+    auto ins = encode(vector_statement{ tokens }, pc, [&](std::size_t i) -> std::optional<std::uint32_t> {
+        auto it = labels.find(std::string(tokens[i].symbol()));
+
+        if(it != labels.end()) {
+            return it->second;
+        }
 
-                    return std::nullopt;
-                }
+        return std::nullopt;
+    }, sink);
 
-                if(shamt > 31 || shamt < 0) {
-                    log << "Invalid shift amounts in instruction near line "
-                        << mnemonic_token.line()
-                        << std::endl;
-                }
+    return single_word(tokens, ins, sink);
+}
 
-                // get base value of instruction
-                // this encodes the upper and lower fields for us
-                // i.e the SPECIAL value, and func value for ALU instructions
-                std::uint32_t ins = instruction_def.value().encoded();
+std::optional<std::uint32_t>
+encode_interned_instruction(const std::vector<token> &tokens,
+                            const std::vector<std::optional<std::uint32_t>>& label_addresses,
+                            diagnostic_sink* sink,
+                            std::uint32_t pc) {
+    auto ins = encode(vector_statement{ tokens }, pc, [&](std::size_t i) -> std::optional<std::uint32_t> {
+        auto id = tokens[i].symbol_id();
+
+        if(id.has_value() && id.value() < label_addresses.size()) {
+            return label_addresses[id.value()];
+        }
 
-                switch(instruction_def.value().instruction_format()) {
-                    case spec::R:
-                        ins |= ((rs     & 0b11111) << 21);
-                        ins |= ((rt     & 0b11111) << 16);
-                        ins |= ((rd     & 0b11111) << 11);
-                        ins |= ((shamt  & 0b11111) <<  6);
-                        std::cout << std::bitset<32>(ins) << std::endl;
-                        return ins;
-                    break;
+        return std::nullopt;
+    }, sink);
 
-                    case spec::I:
-                        std::cout << std::bitset<32>(ins) << std::endl;
-                        ins |= ((rs     & 0b11111) << 21);
-                        std::cout << std::bitset<32>(ins) << std::endl;
-                        ins |= ((rt     & 0b11111) << 16);
-                        std::cout << std::bitset<32>(ins) << std::endl;
-                        ins |= ((imm & 0xFFFF));
-                        std::cout << std::bitset<32>(ins) << std::endl;
+    return single_word(tokens, ins, sink);
+}
 
-                        return ins;
-                    break;
+const encoding_plan* find_statement_plan(const token_stream& tokens, std::size_t begin, std::size_t end,
+                                        diagnostic_sink* sink) {
+    return plan_for(stream_statement{ tokens, begin, end }, sink);
+}
 
-                    case spec::J:
-                        ins |= ((imm & 0x0FFFFFFF) >> 2) & 0b00000011111111111111111111111111;
-                        std::cout << std::bitset<32>(ins) << std::endl;
+void report_out_of_range(const token_stream& tokens, std::size_t begin, const encoded_field& field,
+                         diagnostic_sink& sink) {
+    report_field(stream_statement{ tokens, begin, begin + field.token + 1 }, field, sink);
+}
 
-                        return ins;
-                    break;
-                }
-            }
-            else {
-                log << "Invalid operands near "
-                    << mnemonic_name
-                    << " near line "
-                    << tokens.at(0).line()
-                    << std::endl;
-            }
-        }
-        else {
-            log << "Invalid mnemonic "
-                << mnemonic_name
-                << " near line "
-                << tokens.at(0).line()
-                << std::endl;
-        }
-    }
-    catch(std::bad_variant_access& e) {
-        log  << "Bad attribute "
-             << " near line "
-             << tokens.at(0).line()
-             << std::endl;
-    }
+void trace_encoded(const token_stream& tokens, std::size_t begin, const encoded_words& words, diagnostic_sink& sink) {
+    trace_words(stream_statement{ tokens, begin, begin + 1 }, words, sink);
+}
 
-    return std::nullopt;
+std::size_t statement_words(const token_stream& tokens, std::size_t begin, std::size_t end) {
+    auto plan = find_statement_plan(tokens, begin, end);
+    return plan != nullptr ? plan->words() : 1;
 }
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,132 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#include <vector>
+#include "emitter/encoding_plan.hpp"
+
+namespace as {
+
+std::optional<encoding_plan> encoding_plan::compile(const spec::instruction_def& def, const op_sequence& sequence) {
+    auto& operand_fmt = def.operand_format();
+
+    if(!sequence.supports_operand_format(operand_fmt)) {
+        return std::nullopt;
+    }
+
+    encoding_plan plan;
+
+    // this encodes the upper and lower fields for us
+    // i.e the SPECIAL value, and func value for ALU instructions
+    plan.m_base.words[0] = def.encoded();
+    plan.m_base.size = 1;
+
+    // the word of the instruction fields are added to
+    std::uint8_t word = 0;
+
+    auto add = [&](const std::string& name, range_check check, std::uint8_t align, std::uint8_t shift, std::uint32_t mask,
+                   bool either_sign = false) {
+        auto position = sequence.operand_position(operand_fmt, name);
+
+        if(position.has_value()) {
+            plan.m_fields[plan.m_size++] = {
+                static_cast<std::uint8_t>(position.value()), field_source::NUMBER, check, align, shift, word, mask,
+                either_sign
+            };
+        }
+    };
+
+    auto label_position = sequence.operand_position(operand_fmt, "label");
+
+    auto add_label = [&](field_source source, range_check check, std::uint8_t align, std::uint32_t mask) {
+        plan.m_fields[plan.m_size++] = {
+            static_cast<std::uint8_t>(label_position.value()), source, check, align, 0, word, mask
+        };
+    };
+
+    // a label stands in for an immediate, it's encoded where the immediate would be
+    auto add_immediate = [&](std::uint8_t align, std::uint32_t mask) {
+        if(label_position.has_value()) {
+            add_label(field_source::LABEL, range_check::NONE, align, mask);
+            return;
+        }
+
+        add("imm", range_check::NONE, align, 0, mask);
+    };
+
+    switch(def.instruction_format()) {
+        case spec::R:
+            add("rs",    range_check::ERROR,   0, 21, 0b11111);
+            add("rt",    range_check::ERROR,   0, 16, 0b11111);
+            add("rd",    range_check::ERROR,   0, 11, 0b11111);
+            add("shamt", range_check::WARNING, 0,  6, 0b11111);
+        break;
+
+        case spec::I:
+            // a load or store can't hold a whole address, lw $t0, label is assembled as
+            // lui $at, upper half of label
+            // lw $t0, lower half of label($at)
+            if(label_position.has_value() && operand_fmt == spec::RT_OFFSET_BASE) {
+                auto& lui = spec::instructions::at(spec::instructions::id("lui").value());
+
+                plan.m_base.words = { lui.encoded() | (assembler_temporary << 16), def.encoded() | (assembler_temporary << 21) };
+                plan.m_base.size = 2;
+
+                add_label(field_source::LABEL_HIGH, range_check::NONE, 16, 0xFFFF);
+
+                word = 1;
+                add("rt", range_check::ERROR, 0, 16, 0b11111);
+                add_label(field_source::LABEL, range_check::NONE, 0, 0xFFFF);
+                break;
+            }
+
+            add("rs",    range_check::ERROR,   0, 21, 0b11111);
+            add("rt",    range_check::ERROR,   0, 16, 0b11111);
+
+            // a branch to a label counts the words from the instruction after it
+            if(label_position.has_value()) {
+                add_label(field_source::LABEL_RELATIVE, range_check::ERROR, 2, 0xFFFF);
+                break;
+            }
+
+            // addi $t0, $t0, -1 and ori $t0, $t0, 0xFFFF are both 16 bits, anything wider is an error
+            add("imm",   range_check::ERROR,   0,  0, 0xFFFF, true);
+        break;
+
+        case spec::J:
+            // targets are word aligned, the upper 4 bits come from the pc
+            add_immediate(2, 0x03FFFFFF);
+        break;
+    }
+
+    return plan;
+}
+
+const encoding_plan* encoding_plan::find(std::uint8_t instruction, const op_sequence& sequence) {
+    auto& sequences = op_sequences::all();
+
+    // a plan for every instruction and sequence, indexed by instruction id then sequence
+    static const std::vector<std::optional<encoding_plan>> plans = [&sequences] {
+        std::vector<std::optional<encoding_plan>> compiled;
+        compiled.reserve(spec::instructions::count() * sequences.size());
+
+        for(std::size_t id = 0; id < spec::instructions::count(); ++id) {
+            for(auto& seq : sequences) {
+                compiled.emplace_back(compile(spec::instructions::at(static_cast<std::uint8_t>(id)), seq));
+            }
+        }
+
+        return compiled;
+    }();
+
+    auto index = static_cast<std::size_t>(&sequence - sequences.data());
+
+    if(instruction >= spec::instructions::count() || index >= sequences.size()) {
+        return nullptr;
+    }
+
+    auto& plan = plans[instruction * sequences.size() + index];
+    return plan.has_value() ? &plan.value() : nullptr;
+}
+
+}
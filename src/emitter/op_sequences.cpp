@@ -4,8 +4,10 @@
 
 #include "emitter/op_sequences.hpp"
 #include "emitter/emitter.hpp"
+#include <algorithm>
 #include <map>
 #include <unordered_map>
+#include <utility>
 
 namespace as {
 
@@ -14,12 +16,14 @@ op_sequence::op_sequence(
     const std::vector<as::token_type> &token_types,
     const as::op_sequence::operand_locations &locations) :
     m_token_types(token_types),
+    m_signature(op_signature::of(token_types)),
     m_operand_locations(locations) {
 
 }
 
 op_sequence::op_sequence(const std::vector<token_type> &types) :
-    m_token_types(types) {
+    m_token_types(types),
+    m_signature(op_signature::of(types)) {
 
 }
 
@@ -49,6 +53,36 @@ std::optional<std::size_t> op_sequence::operand_position(
     return std::nullopt;
 }
 
+const op_sequence* op_sequences::find(const op_signature& signature) {
+    using entry = std::pair<op_signature, const op_sequence*>;
+
+    // built on first use, after the sequences are
+    static const std::vector<entry> index = [] {
+        std::vector<entry> entries;
+
+        for(auto& sequence : sequences) {
+            entries.emplace_back(sequence.signature(), &sequence);
+        }
+
+        // the first sequence of a signature wins, as it did when they were compared in order
+        std::stable_sort(entries.begin(), entries.end(), [](const entry& a, const entry& b) {
+            return a.first < b.first;
+        });
+
+        return entries;
+    }();
+
+    auto it = std::lower_bound(index.begin(), index.end(), signature, [](const entry& e, const op_signature& s) {
+        return e.first < s;
+    });
+
+    if(it == index.end() || !(it->first == signature)) {
+        return nullptr;
+    }
+
+    return it->second;
+}
+
 using t = token_type;
 const std::vector<op_sequence> op_sequences::sequences = {
     {   // op $reg, $reg, $reg
@@ -85,6 +119,14 @@ const std::vector<op_sequence> op_sequences::sequences = {
         }
     },
 
+    {   // op $reg, $reg, label
+        // e.g. bne $t0, $zero, loop
+        { t::MNEMONIC, t::REGISTER, t::COMMA, t::REGISTER, t::COMMA, t::LABEL },
+        {
+            { spec::RS_RT_OFFSET, { {"rs", 1}, {"rt", 3}, {"label", 5 } } },
+        }
+    },
+
     {   // op $reg, offset($reg_base)
         {t::MNEMONIC, t::REGISTER, t::COMMA, t::REGISTER, t::COMMA, t::OFFSET, t::BASE_REGISTER },
         {
@@ -92,6 +134,14 @@ const std::vector<op_sequence> op_sequences::sequences = {
         }
     },
 
+    {   // op $reg, offset($reg_base)
+        //          ^-- the base is rs
+        {t::MNEMONIC, t::REGISTER, t::COMMA, t::OFFSET, t::BASE_REGISTER },
+        {
+            {spec::RT_OFFSET_BASE, { {"rt", 1}, {"imm", 3}, {"rs", 4} } }
+        }
+    },
+
     {   // op $reg, offset
         //              ^-- a literal number
         {t::MNEMONIC, t::REGISTER, t::COMMA, t::LITERAL_NUMBER },
@@ -101,6 +151,15 @@ const std::vector<op_sequence> op_sequences::sequences = {
         }
     },
 
+    {   // op $reg, label
+        // e.g. blez $t0, done or lw $t0, msg
+        {t::MNEMONIC, t::REGISTER, t::COMMA, t::LABEL },
+        {
+            { spec::RS_OFFSET,      { {"rs", 1}, {"label", 3} } },
+            { spec::RT_OFFSET_BASE, { {"rt", 1}, {"label", 3} } }
+        }
+    },
+
 
     {   // op number
         // e.g. j 80
@@ -0,0 +1,139 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#include "fsm/profiler.hpp"
+
+#include <iomanip>
+
+namespace as {
+
+namespace {
+
+// Escape a name for a JSON or dot string, both escape the same characters
+std::string escaped(const std::string& name) {
+    std::string out;
+
+    for(char ch : name) {
+        if(ch == '"' || ch == '\\') {
+            out += '\\';
+        }
+
+        out += ch;
+    }
+
+    return out;
+}
+
+std::string quoted(const std::string& name) {
+    std::string out = "\"";
+    out += escaped(name);
+    out += '"';
+
+    return out;
+}
+
+double microseconds(std::chrono::nanoseconds time) {
+    return std::chrono::duration<double, std::micro>(time).count();
+}
+
+}
+
+std::string profiler::state_name(std::size_t state) const {
+    if(state < m_state_names.size() && !m_state_names[state].empty()) {
+        return m_state_names[state];
+    }
+
+    return std::to_string(state);
+}
+
+void profiler::reset() {
+    m_states.clear();
+
+    for(auto& transition : m_transitions) {
+        transition.fired = 0;
+    }
+}
+
+void profiler::write_text(std::ostream& out) const {
+    auto flags = out.flags();
+
+    out << std::left << std::setw(28) << "state" << std::right
+        << std::setw(14) << "ticks"
+        << std::setw(16) << "no transition"
+        << std::setw(10) << "skips"
+        << std::setw(16) << "skipped bytes"
+        << std::setw(14) << "time (us)" << '\n';
+
+    for(std::size_t state = 0; state < m_states.size(); ++state) {
+        auto& s = m_states[state];
+
+        out << std::left << std::setw(28) << state_name(state) << std::right
+            << std::setw(14) << s.ticks
+            << std::setw(16) << s.no_transitions
+            << std::setw(10) << s.skips
+            << std::setw(16) << s.skipped_bytes
+            << std::setw(14) << std::fixed << std::setprecision(1) << microseconds(s.time) << '\n';
+    }
+
+    out << '\n' << std::left << std::setw(56) << "transition" << std::right << std::setw(14) << "fired" << '\n';
+
+    for(auto& transition : m_transitions) {
+        out << std::left << std::setw(56) << state_name(transition.from) + " -> " + state_name(transition.to)
+            << std::right << std::setw(14) << transition.fired << '\n';
+    }
+
+    out.flags(flags);
+}
+
+void profiler::write_json(std::ostream& out) const {
+    out << "{\"states\":[";
+
+    for(std::size_t state = 0; state < m_states.size(); ++state) {
+        auto& s = m_states[state];
+
+        out << (state > 0 ? "," : "")
+            << "{\"state\":" << quoted(state_name(state))
+            << ",\"ticks\":" << s.ticks
+            << ",\"no_transitions\":" << s.no_transitions
+            << ",\"skips\":" << s.skips
+            << ",\"skipped_bytes\":" << s.skipped_bytes
+            << ",\"nanoseconds\":" << s.time.count() << "}";
+    }
+
+    out << "],\"transitions\":[";
+
+    bool first = true;
+
+    for(auto& transition : m_transitions) {
+        out << (first ? "" : ",")
+            << "{\"from\":" << quoted(state_name(transition.from))
+            << ",\"to\":" << quoted(state_name(transition.to))
+            << ",\"fired\":" << transition.fired << "}";
+
+        first = false;
+    }
+
+    out << "]}\n";
+}
+
+void profiler::write_dot(std::ostream& out) const {
+    out << "digraph fsm {\n";
+
+    for(std::size_t state = 0; state < m_states.size(); ++state) {
+        auto& s = m_states[state];
+
+        out << "    " << quoted(state_name(state))
+            << " [label=\"" << escaped(state_name(state)) << "\\n"
+            << s.ticks << " ticks, " << s.time.count() / 1000 << " us\"];\n";
+    }
+
+    for(auto& transition : m_transitions) {
+        out << "    " << quoted(state_name(transition.from)) << " -> " << quoted(state_name(transition.to))
+            << " [label=\"" << transition.fired << "\"" << (transition.fired == 0 ? ", style=dashed" : "") << "];\n";
+    }
+
+    out << "}\n";
+}
+
+}
@@ -0,0 +1,90 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#include "io/mapped_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace as {
+
+std::optional<mapped_file> mapped_file::open(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+
+    if(fd < 0) {
+        return std::nullopt;
+    }
+
+    struct stat st = { };
+
+    if(::fstat(fd, &st) != 0) {
+        ::close(fd);
+        return std::nullopt;
+    }
+
+    auto size = static_cast<std::size_t>(st.st_size);
+
+    // empty files can't be mapped, but they're still valid input
+    if(size == 0) {
+        ::close(fd);
+        return mapped_file(nullptr, 0);
+    }
+
+    void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // the mapping keeps the file referenced
+    ::close(fd);
+
+    if(data == MAP_FAILED) {
+        return std::nullopt;
+    }
+
+    ::madvise(data, size, MADV_SEQUENTIAL);
+
+    return mapped_file(data, size);
+}
+
+mapped_file::mapped_file(void* data, std::size_t size) :
+    m_data(data),
+    m_size(size)
+{
+
+}
+
+mapped_file::mapped_file(mapped_file&& other) noexcept :
+    m_data(other.m_data),
+    m_size(other.m_size)
+{
+    other.m_data = nullptr;
+    other.m_size = 0;
+}
+
+mapped_file& mapped_file::operator=(mapped_file&& other) noexcept {
+    if(this != &other) {
+        unmap();
+
+        m_data = other.m_data;
+        m_size = other.m_size;
+
+        other.m_data = nullptr;
+        other.m_size = 0;
+    }
+
+    return *this;
+}
+
+mapped_file::~mapped_file() {
+    unmap();
+}
+
+void mapped_file::unmap() {
+    if(m_data != nullptr) {
+        ::munmap(m_data, m_size);
+        m_data = nullptr;
+    }
+}
+
+}
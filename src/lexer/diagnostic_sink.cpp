@@ -0,0 +1,47 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#include <algorithm>
+#include "lexer/diagnostic_sink.hpp"
+
+namespace as {
+
+bool diagnostic_list::has_errors() const {
+    return std::any_of(m_diagnostics.begin(), m_diagnostics.end(), [](const diagnostic& d) {
+        return d.level == severity::ERROR;
+    });
+}
+
+void diagnostic_list::accept(diagnostic&& error) {
+    m_diagnostics.emplace_back(std::move(error));
+}
+
+diagnostic_printer::diagnostic_printer(std::ostream& out, std::optional<std::string_view> source, severity least) :
+    diagnostic_sink(least),
+    m_out(out)
+{
+    if(source.has_value()) {
+        m_lines.emplace(source.value());
+    }
+}
+
+void diagnostic_printer::accept(diagnostic&& error) {
+    switch(error.level) {
+        case severity::TRACE:   m_out << "trace: ";   break;
+        case severity::NOTE:    m_out << "note: ";    break;
+        case severity::WARNING: m_out << "warning: "; break;
+        case severity::ERROR:   break;
+    }
+
+    if(m_lines.has_value()) {
+        auto location = m_lines->locate(error.offset);
+
+        error.line   = location.line;
+        error.column = location.column;
+    }
+
+    m_out << error.reason << " at line " << error.line << ", column " << error.column << std::endl;
+}
+
+}
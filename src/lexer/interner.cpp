@@ -0,0 +1,35 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#include "lexer/interner.hpp"
+
+namespace as {
+
+std::uint32_t interner::intern(std::string_view name) {
+    auto it = m_ids.find(name);
+
+    if(it != m_ids.end()) {
+        return it->second;
+    }
+
+    auto id = static_cast<std::uint32_t>(m_names.size());
+    auto stored = m_arena.store(name);
+
+    m_names.push_back(stored);
+    m_ids.emplace(stored, id);
+
+    return id;
+}
+
+std::optional<std::uint32_t> interner::find(std::string_view name) const {
+    auto it = m_ids.find(name);
+
+    if(it != m_ids.end()) {
+        return it->second;
+    }
+
+    return std::nullopt;
+}
+
+}
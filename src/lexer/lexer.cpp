@@ -2,448 +2,1213 @@
 // Created by ocanty on 16/01/19.
 //
 
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <limits>
 #include <string>
-#include <sstream>
-#include <regex>
+#include <string_view>
+#include <iostream>
+#include <thread>
 #include "lexer/lexer.hpp"
-#include "fsm/transition.hpp"
+#include "lexer/line_index.hpp"
+#include "lexer/char_class.hpp"
+#include "lexer/scan.hpp"
+#include "fsm/static_finite_state_machine.hpp"
 #include "spec/instruction_defs.hpp"
 #include "spec/registers.hpp"
 #include "lexer/token.hpp"
 
 namespace as {
 
-lexer::lexer() :
-    m_fsm(states::BASE) {
-    setup_fsm();
+namespace {
+
+// Character classes tested by the lexer transitions,
+// these are built at compile time so testing a character is a table lookup
+constexpr char_class lower        = char_class::range('a', 'z');
+constexpr char_class upper        = char_class::range('A', 'Z');
+constexpr char_class digit        = char_class::range('0', '9');
+constexpr char_class alpha        = lower | upper;
+constexpr char_class ident_start  = alpha | "_";
+constexpr char_class ident        = ident_start | digit;
+constexpr char_class lower_alnum  = lower | digit;
+constexpr char_class alnum        = alpha | digit;
+constexpr char_class number_start = digit | "-+";
+
+constexpr char_class comma        = ",";
+constexpr char_class new_line     = "\n";
+constexpr char_class not_new_line = ~new_line;
+constexpr char_class whitespace   = " \t\r";
+constexpr char_class dot          = ".";
+constexpr char_class colon        = ":";
+constexpr char_class hash         = "#";
+constexpr char_class dollar       = "$";
+constexpr char_class double_quote = "\"";
+constexpr char_class single_quote = "'";
+constexpr char_class open_paren   = "(";
+constexpr char_class close_paren  = ")";
+
+// tabs and carriage returns are whitespace too, so sources don't need normalizing
+constexpr char_class space_or_new_line       = whitespace | new_line;
+constexpr char_class comma_space_or_new_line = comma | whitespace | new_line;
+constexpr char_class directive_char_or_end   = alpha | whitespace | new_line;
+
+// The characters each state has a transition for, any other is an unexpected character
+constexpr char_class base_char          = comma | space_or_new_line | dot | ident_start | hash | dollar |
+                                          double_quote | single_quote | number_start;
+constexpr char_class label_char         = ident | comma_space_or_new_line | colon;
+constexpr char_class register_char      = lower_alnum | comma_space_or_new_line;
+constexpr char_class number_char        = alnum | comma_space_or_new_line | open_paren;
+constexpr char_class base_register_char = lower_alnum | close_paren;
+
+// The same sets as ranges, for skipping whole spans at once
+constexpr byte_ranges ident_ranges        = { {'a', 'z'}, {'A', 'Z'}, {'0', '9'}, {'_', '_'} };
+constexpr byte_ranges new_line_ranges     = { {'\n', '\n'} };
+constexpr byte_ranges double_quote_ranges = { {'"', '"'} };
+
+// Transition condition that will return true when a char is in the character class
+template <const char_class& Class>
+bool match_class(lexer_context& lex) {
+    return Class.contains(lex.ch());
 }
 
-void lexer::setup_fsm() {
-    // Transition callback that will simply consume the character into the character buffer
-    auto consume_char = [&](lexer_context& lex) {
-        lex.consume(lex.ch());
-    };
+// the above, just not'ed
+template <const char_class& Class>
+bool not_match_class(lexer_context& lex) {
+    return !Class.contains(lex.ch());
+}
 
-    // Transition callback generator that pushes an
-    // invalid_token to the token buffer for a given reason
-    auto push_invalid_token = [](const std::string& reason) -> auto {
-        return transition<states, lexer_context>::transition_callback_func(
-            [&reason](lexer_context& lex) -> void {
-                // Push invalid token with error reason
-                lex.push_token(
-                    token_type::INVALID_TOKEN,
-                    reason            +
-                    " near '"         +
-                    lex.char_buffer().str() +
-                    "' at line "      +
-                    std::to_string(lex.cur_line())
-                );
-
-                lex.clear_char_buffer();
-            }
-        );
-    };
+// Parses a register from a register string, expects the $ to be removed
+// i.e. valid inputs -> "31", "02", "t0", etc...
+// as specified in spec::registers
+std::optional<std::uint8_t> get_register_id(std::string_view lexeme) {
+    if(lexeme.empty()) {
+        return std::nullopt;
+    }
 
-    // Generate's a should_transition_func
-    // that will return true when a char matches the supplied regex
-    auto match_pattern = [](const std::string& regex) -> auto {
-        return transition<states, lexer_context>::should_transition_func(
-            [=](lexer_context& lex) -> bool {
-                return std::regex_match(std::string(1,lex.ch()), std::regex(regex));
-            }
-        );
-    };
+    // check if it's a number
+    if(digit.contains(lexeme.front())) {
+        unsigned id = 0;
+        auto end = lexeme.data() + lexeme.size();
+        auto [ptr, ec] = std::from_chars(lexeme.data(), end, id);
 
-    // the above, just not'ed
-    auto not_match_pattern = [](const std::string& regex) -> auto {
-        return transition<states, lexer_context>::should_transition_func(
-            [regex](lexer_context& lex) -> bool {
-                return !std::regex_match(std::string(1,lex.ch()), std::regex(regex));
-            }
-        );
-    };
+        if(ec == std::errc() && ptr == end && id < 32) {
+            return static_cast<std::uint8_t>(id);
+        }
+
+        return std::nullopt;
+    }
 
-    // Parses a register from a register string, expects the $ to be removed
-    // i.e. valid inputs -> "31", "02", "t0", etc...
-    // as specified in spec::registers
-    auto get_register_id = [](const std::string& lexeme) -> std::optional<std::uint8_t> {
-        // check if it's a number
-        try {
-            int i_dec = std::stoi(lexeme);
+    // check if its a named register (if its not a number)
+    return spec::find_register(lexeme);
+}
 
-            if (i_dec > 0 && i_dec < 32) {
-                return i_dec;
-            }
-        }
-        catch(const std::invalid_argument& e) {
-            // check if its a named register (if its not a number)
-            if(spec::registers.count(lexeme)) {
-                return spec::registers.at(lexeme);
-            }
+// Parses a number literal, i.e. "100", "-4", "0x1F", "0b101", "017" (octal)
+// Anything from INT32_MIN up to UINT32_MAX is accepted, so 32-bit hex masks can be written as is
+std::optional<std::int32_t> parse_number(std::string_view lexeme) {
+    bool negative = false;
+
+    if(!lexeme.empty() && (lexeme.front() == '-' || lexeme.front() == '+')) {
+        negative = lexeme.front() == '-';
+        lexeme.remove_prefix(1);
+    }
+
+    int base = 10;
+
+    if(lexeme.size() > 2 && lexeme[0] == '0' && (lexeme[1] == 'x' || lexeme[1] == 'X')) {
+        base = 16;
+        lexeme.remove_prefix(2);
+    } else if(lexeme.size() > 2 && lexeme[0] == '0' && (lexeme[1] == 'b' || lexeme[1] == 'B')) {
+        base = 2;
+        lexeme.remove_prefix(2);
+    } else if(lexeme.size() > 1 && lexeme[0] == '0') {
+        base = 8;
+        lexeme.remove_prefix(1);
+    }
+
+    // from_chars would accept a second sign
+    if(lexeme.empty() || lexeme.front() == '-' || lexeme.front() == '+') {
+        return std::nullopt;
+    }
+
+    std::uint64_t value = 0;
+    auto end = lexeme.data() + lexeme.size();
+    auto [ptr, ec] = std::from_chars(lexeme.data(), end, value, base);
+
+    if(ec != std::errc() || ptr != end) {
+        return std::nullopt;
+    }
+
+    if(negative) {
+        if(value > std::uint64_t(1) << 31) {
+            return std::nullopt;
         }
 
+        return static_cast<std::int32_t>(-static_cast<std::int64_t>(value));
+    }
+
+    if(value > std::numeric_limits<std::uint32_t>::max()) {
         return std::nullopt;
-    };
+    }
 
-    m_fsm.add_transitions(
-    {
+    return static_cast<std::int32_t>(static_cast<std::uint32_t>(value));
+}
 
-    // Comma
-    {
-        states::BASE, states::BASE,
-        match_pattern("[,]"),
-        [&](lexer_context& lex) -> void {
-            lex.push_token(token_type::COMMA);
+// Count the newlines in a block of at most 255 bytes
+// The count fits in a byte, so the compiler can vectorize this to compare and add 16 or 32 bytes at a time
+std::size_t count_new_lines(const char* block, std::size_t size) {
+    std::uint8_t count = 0;
+
+    for(std::size_t i = 0; i < size; ++i) {
+        count += block[i] == '\n';
+    }
+
+    return count;
+}
+
+// Count the newlines in a source, a block at a time
+std::size_t count_new_lines(std::string_view source) {
+    constexpr std::size_t block_size = 255;
+
+    std::size_t count = 0;
+
+    for(std::size_t pos = 0; pos < source.size(); pos += block_size) {
+        count += count_new_lines(source.data() + pos, std::min(block_size, source.size() - pos));
+    }
+
+    return count;
+}
+
+// Offset of the start of the count'th line after from, or the end of the source if it has fewer lines
+// Whole blocks are skipped by counting their newlines rather than finding each one
+std::size_t skip_lines(std::string_view source, std::size_t count, std::size_t from = 0) {
+    constexpr std::size_t block_size = 255;
+
+    std::size_t pos = from;
+
+    while(count > 0 && source.size() - pos >= block_size) {
+        auto block = count_new_lines(source.data() + pos, block_size);
+
+        if(block >= count) {
+            break;
         }
-    },
 
-    {
-        states::BASE, states::BASE,
-        match_pattern("[\\n]"),
-        [&](lexer_context& lex) -> void {
-            lex.push_token(token_type::NEW_LINE);
+        count -= block;
+        pos += block_size;
+    }
+
+    for(; count > 0; --count) {
+        auto new_line = source.find('\n', pos);
+
+        if(new_line == std::string_view::npos) {
+            return source.size();
         }
-    },
-        
+
+        pos = new_line + 1;
+    }
+
+    return pos;
+}
+
+// Tokens whose attribute is a symbol that gets interned
+bool is_symbol_token(token_type type) {
+    return type == token_type::DIRECTIVE || type == token_type::MNEMONIC ||
+           type == token_type::LABEL     || type == token_type::LABEL_DEFINITION;
+}
+
+// Whether the lexeme is an instruction mnemonic
+// When it has been interned, each distinct symbol is only looked up once
+bool lexeme_is_mnemonic(lexer_context& lex, const std::optional<std::uint32_t>& id) {
+    if(!id.has_value()) {
+        return spec::instructions::exists(lex.lexeme());
+    }
+
+    auto& mnemonic_ids = lex.mnemonic_ids();
+
+    if(id.value() >= mnemonic_ids.size()) {
+        mnemonic_ids.resize(id.value() + 1, -1);
+    }
+
+    if(mnemonic_ids[id.value()] < 0) {
+        mnemonic_ids[id.value()] = spec::instructions::exists(lex.lexeme());
+    }
+
+    return mnemonic_ids[id.value()] != 0;
+}
+
+// Find the line and column of a diagnostic from its offset
+void locate_diagnostic(line_index& lines, diagnostic& error) {
+    auto location = lines.locate(error.offset);
+
+    error.line   = location.line;
+    error.column = location.column;
+}
+
+void locate_diagnostics(std::string_view source, std::vector<diagnostic>& errors) {
+    line_index lines(source);
+
+    for(auto& error : errors) {
+        locate_diagnostic(lines, error);
+    }
+}
+
+// pass errors to a sink, they have already been located
+void report_diagnostics(diagnostic_sink& sink, std::vector<diagnostic>& errors) {
+    for(auto& error : errors) {
+        sink.report(std::move(error));
+    }
+}
+
+constexpr const char* too_large_reason = "Source is too large, it must be smaller than 4 GiB";
+
+// Rejects a source whose offsets wouldn't fit in a token, with an error at its start
+bool source_too_large(std::string_view input, std::vector<diagnostic>& diagnostics) {
+    if(input.size() <= lexer::max_source_size) {
+        return false;
+    }
+
+    diagnostics.push_back({ 0, 0, 0, too_large_reason });
+    return true;
+}
+
+// Reports an error, and replaces the statement it is in with an invalid token for the given reason
+void push_invalid_token(lexer_context& lex, const std::string& reason) {
+    std::string message = reason + " near '" + std::string(lex.lexeme()) + "'";
+
+    lex.report(message);
+    lex.discard_statement();
+    lex.push_token(token_type::INVALID_TOKEN, message);
+
+    lex.clear_lexeme();
+}
+
+// A character no transition of the current state is for, it is shown at the end of the lexeme
+// A newline isn't, it still ends the line
+void unexpected_char(lexer_context& lex) {
+    if(lex.ch() != '\n') {
+        lex.consume();
+    }
+
+    push_invalid_token(lex, "Unexpected character");
+}
+
+// A string or character literal still open at the end of the source, it is reported where it started
+// Its lexeme isn't shown, it is the rest of the source
+void unterminated_literal(lexer_context& lex, const std::string& reason) {
+    lex.report(reason);
+    lex.discard_statement();
+    lex.push_token(token_type::INVALID_TOKEN, reason);
+
+    lex.clear_lexeme();
+}
+
+// Transition callback that will simply consume the character into the lexeme
+void consume_char(lexer_context& lex) {
+    lex.consume();
+}
+
+// Scanners for the states that skip runs of characters, they find the terminator 16 or 32 bytes at a time
+const char* skip_to_new_line(const char* begin, const char* end) {
+    return find_first_in(begin, end, new_line_ranges);
+}
+
+const char* skip_to_double_quote(const char* begin, const char* end) {
+    return find_first_in(begin, end, double_quote_ranges);
+}
+
+const char* skip_identifier(const char* begin, const char* end) {
+    return find_first_not_in(begin, end, ident_ranges);
+}
+
+// Skip callback that consumes the whole span into the lexeme
+void consume_span(lexer_context& lex, const char* begin, const char* end) {
+    lex.consume_span(begin, end);
+}
+
+void push_comma(lexer_context& lex) {
+    lex.push_token(token_type::COMMA);
+}
+
+void push_new_line(lexer_context& lex) {
+    lex.push_token(token_type::NEW_LINE);
+}
+
+void finish_directive(lexer_context& lex) {
+    lex.push_symbol_token(token_type::DIRECTIVE, lex.intern_lexeme());
+    lex.clear_lexeme();
+
+    if(lex.ch() == '\n') {
+        lex.push_token(token_type::NEW_LINE);
+    }
+}
+
+void invalid_directive(lexer_context& lex) {
+    push_invalid_token(lex, "Invalid directive characters");
+}
+
+// Here we need to check if it's a instruction first,
+// and if it isn't it's a label
+void finish_label_or_mnemonic(lexer_context& lex) {
+    auto id = lex.intern_lexeme();
+
+    // if we have an instruction that matches the lexeme
+    if (lexeme_is_mnemonic(lex, id)) {
+        lex.push_symbol_token(token_type::MNEMONIC, id);
+        lex.clear_lexeme();
+    } else {
+        // it's a label
+        lex.push_symbol_token(token_type::LABEL, id);
+        lex.clear_lexeme();
+    }
+
+    if(lex.ch() == ',') {
+        lex.push_token(token_type::COMMA);
+    }
+
+    if(lex.ch() == '\n') {
+        lex.push_token(token_type::NEW_LINE);
+    }
+}
+
+void finish_label_definition(lexer_context& lex) {
+    auto id = lex.intern_lexeme();
+
+    // can't use an instruction as a label definition
+    if(lexeme_is_mnemonic(lex, id)) {
+        return push_invalid_token(lex, "Using a reserved keyword as a label definition");
+    } else {
+        // it's a label
+        lex.push_symbol_token(token_type::LABEL_DEFINITION, id);
+        lex.clear_lexeme();
+    }
+}
+
+void finish_register(lexer_context& lex) {
+    auto reg = get_register_id(lex.lexeme());
+
+    if(reg != std::nullopt) {
+        lex.push_token(token_type::REGISTER, reg.value());
+        lex.clear_lexeme();
+    }
+    else {
+        return push_invalid_token(lex, "Invalid register");
+    }
+
+    if(lex.ch() == ',') {
+        lex.push_token(token_type::COMMA);
+    }
+
+    if(lex.ch() == '\n') {
+        lex.push_token(token_type::NEW_LINE);
+    }
+}
+
+void finish_literal_string(lexer_context& lex) {
+    lex.push_lexeme_token(token_type::LITERAL_STRING);
+    lex.clear_lexeme();
+}
+
+void finish_literal_char(lexer_context& lex) {
+    if(lex.lexeme().size() > 1) {
+        return push_invalid_token(lex, "Invalid character literal");
+    }
+
+    lex.push_lexeme_token(token_type::LITERAL_CHAR);
+    lex.clear_lexeme();
+}
+
+void finish_literal_number(lexer_context& lex) {
+    auto number = parse_number(lex.lexeme());
+
+    if(number != std::nullopt) {
+        lex.push_token(token_type::LITERAL_NUMBER, number.value());
+        lex.clear_lexeme();
+    } else {
+        return push_invalid_token(lex, "Invalid number literal");
+    }
+
+    if(lex.ch() == ',') {
+        lex.push_token(token_type::COMMA);
+    }
+
+    if(lex.ch() == '\n') {
+        lex.push_token(token_type::NEW_LINE);
+    }
+}
+
+void finish_offset(lexer_context& lex) {
+    auto number = parse_number(lex.lexeme());
+
+    if(number != std::nullopt) {
+        lex.push_token(token_type::OFFSET, number.value());
+        lex.clear_lexeme();
+    } else {
+        return push_invalid_token(lex, "Invalid number literal");
+    }
+}
+
+void finish_base_register(lexer_context& lex) {
+    auto reg = get_register_id(lex.lexeme());
+
+    if(reg != std::nullopt) {
+        lex.push_token(token_type::BASE_REGISTER, reg.value());
+        lex.clear_lexeme();
+    } else {
+        return push_invalid_token(lex, "Invalid register");
+    }
+}
+
+}
+
+/**
+ * The transitions of the lexer's FSM, these are all known at compile time
+ */
+struct lexer::fsm {
+    using s = states;
+
+    template <typename Profiler>
+    using basic_machine = basic_static_finite_state_machine<states, lexer_context, Profiler,
+
+    // Comma
+    static_transition<s::BASE, s::BASE,
+        &match_class<comma>, &push_comma>,
+
+    static_transition<s::BASE, s::BASE,
+        &match_class<new_line>, &push_new_line>,
+
     // Begin directive - '.data'
-    {
-        states::BASE, states::SEEK_DIRECTIVE,
-        match_pattern("[\\.]")
-    },
+    static_transition<s::BASE, s::SEEK_DIRECTIVE,
+        &match_class<dot>>,
 
     // Eat directive - '.data'
     //                   ^^^^
-    {
-        states::SEEK_DIRECTIVE, states::SEEK_DIRECTIVE,
-        match_pattern("[a-zA-Z]"),
-        consume_char
-    },
-    
+    static_transition<s::SEEK_DIRECTIVE, s::SEEK_DIRECTIVE,
+        &match_class<alpha>, &consume_char>,
+
     // Finish directive - '.data\n' or '.data '
     //                          ^^           ^
-    {
-        states::SEEK_DIRECTIVE, states::BASE,
-        match_pattern("[ ]|[\\n]"),
-        [&](lexer_context& lex) -> void {
-            lex.push_token(token_type::DIRECTIVE, lex.char_buffer().str());
-            lex.clear_char_buffer();
-
-            if(lex.ch() == '\n') {
-                lex.push_token(token_type::NEW_LINE);
-            }
-        }
-    },
+    static_transition<s::SEEK_DIRECTIVE, s::BASE,
+        &match_class<space_or_new_line>, &finish_directive>,
 
     // Invalid directive '.data./$'
     //                         ^^^
-    {
-        states::SEEK_DIRECTIVE, states::INVALID_TOKEN,
-        not_match_pattern("[a-zA-Z]|[ ]|[\\n]"),
-        push_invalid_token("Invalid directive characters")
-    },
+    static_transition<s::SEEK_DIRECTIVE, s::INVALID_TOKEN,
+        &not_match_class<directive_char_or_end>, &invalid_directive>,
 
     // Begin label or mnemonic - 'mov ' or 'mov\n' or 'movie_label ' or 'movie_label\n'
     //                            ^         ^          ^                 ^
     // We determine if it's a label or instruction when we reach the terminating character
     // i.e the space or new line
-    {
-        states::BASE, states::SEEK_LABEL_OR_MNEMONIC,
-        match_pattern("[_a-zA-Z]"),
-        consume_char
-    },
+    static_transition<s::BASE, s::SEEK_LABEL_OR_MNEMONIC,
+        &match_class<ident_start>, &consume_char>,
 
     // Eat label or mnemonic - 'mov ' or 'mov\n' or 'movie_label ' or 'movie_label\n'
     //                           ^^        ^^         ^^^^^^^^^^        ^^^^^^^^^^
-    {
-        states::SEEK_LABEL_OR_MNEMONIC, states::SEEK_LABEL_OR_MNEMONIC,
-        match_pattern("[_a-zA-Z0-9]"),
-        consume_char
-    },
-
-    // Finish label - 'mov ' or 'mov\n' or 'movie_label ' or 'movie_label\n'
-    //                    ^         ^                  ^                 ^
-    // Here we need to check if it's a instruction first,
-    // and if it isn't it's a label
-    {
-        states::SEEK_LABEL_OR_MNEMONIC, states::BASE,
-        match_pattern("[ ]|[\\n]"),
-        [&](lexer_context &lex) -> void {
-            auto char_buffer = lex.char_buffer().str();
-
-            // if we have an instruction that matches the char buffer
-            if (spec::instructions::exists(char_buffer)) {
-                lex.push_token(token_type::MNEMONIC, char_buffer);
-                lex.clear_char_buffer();
-            } else {
-                // it's a label
-                lex.push_token(token_type::LABEL, char_buffer);
-                lex.clear_char_buffer();
-            }
+    static_transition<s::SEEK_LABEL_OR_MNEMONIC, s::SEEK_LABEL_OR_MNEMONIC,
+        &match_class<ident>, &consume_char>,
 
-            if(lex.ch() == '\n') {
-                lex.push_token(token_type::NEW_LINE);
-            }
-        }
-    },
+    // Finish label - 'mov ' or 'mov\n' or 'movie_label ' or 'movie_label\n' or 'movie_label,'
+    //                    ^         ^                  ^                 ^                  ^
+    static_transition<s::SEEK_LABEL_OR_MNEMONIC, s::BASE,
+        &match_class<comma_space_or_new_line>, &finish_label_or_mnemonic>,
 
     // If a semi-colon follows the label, it's actually a label definition
-    //
-    {
-        states::SEEK_LABEL_OR_MNEMONIC, states::BASE,
-        match_pattern("[:]"),
-        [&](lexer_context& lex) -> void {
-            auto char_buffer = lex.char_buffer().str();
-
-            // can't use an instruction as a label definition
-            if(spec::instructions::exists(char_buffer)) {
-                return push_invalid_token("Using a reserved keyword as a label definition")(lex);
-            } else {
-                // it's a label
-                lex.push_token(token_type::LABEL_DEFINITION, char_buffer);
-                lex.clear_char_buffer();
-            }
-        }
-    },
+    static_transition<s::SEEK_LABEL_OR_MNEMONIC, s::BASE,
+        &match_class<colon>, &finish_label_definition>,
 
-    // Invalid directive '.data./$'
-    //                         ^^^
-    {
-        states::SEEK_DIRECTIVE, states::INVALID_TOKEN,
-        not_match_pattern("[a-zA-Z]|[ ]|[\\n]"),
-        push_invalid_token("Invalid directive characters")
-    },
+    // Any other character is invalid, in an identifier or between tokens - 'main@' or 'add $t0, $t1, $t2 @@@'
+    static_transition<s::SEEK_LABEL_OR_MNEMONIC, s::INVALID_TOKEN,
+        &not_match_class<label_char>, &unexpected_char>,
+
+    static_transition<s::BASE, s::INVALID_TOKEN,
+        &not_match_class<base_char>, &unexpected_char>,
 
     // Comments, we ignore till newline
-    {
-        states::BASE, states::SEEK_COMMENT,
-        match_pattern("[#]")
-    },
-
-    // matches everything inside a comment
-    {
-        states::SEEK_COMMENT, states::SEEK_COMMENT,
-        match_pattern("[.]")
-    },
-
-    // exit comment seeking on newline
-    {
-        states::SEEK_COMMENT, states::BASE,
-        match_pattern("[\\n]")
-    },
+    static_transition<s::BASE, s::SEEK_COMMENT,
+        &match_class<hash>>,
+
+    // matches everything inside a comment (up to the newline)
+    static_transition<s::SEEK_COMMENT, s::SEEK_COMMENT,
+        &match_class<not_new_line>>,
+
+    // exit comment seeking on newline, the newline still ends the statement
+    static_transition<s::SEEK_COMMENT, s::BASE,
+        &match_class<new_line>, &push_new_line>,
+
+    // after an invalid token the rest of its line is skipped, lexing starts again on the next
+    static_transition<s::INVALID_TOKEN, s::INVALID_TOKEN,
+        &match_class<not_new_line>>,
+
+    static_transition<s::INVALID_TOKEN, s::BASE,
+        &match_class<new_line>, &push_new_line>,
 
     // Register $reg
     //          ^
-    {
-        states::BASE, states::SEEK_REGISTER,
-        match_pattern("[\\$]")
-    },
-
-    {
-        // seek each character of the register declaration
-        states::SEEK_REGISTER, states::SEEK_REGISTER,
-        match_pattern("[a-z0-9]"),
-        consume_char
-    },
+    static_transition<s::BASE, s::SEEK_REGISTER,
+        &match_class<dollar>>,
+
+    // seek each character of the register declaration
+    static_transition<s::SEEK_REGISTER, s::SEEK_REGISTER,
+        &match_class<lower_alnum>, &consume_char>,
 
     // When we reach the end of a register declaration
     // delimited by "," or " " or "\n"
-    {
-        states::SEEK_REGISTER, states::BASE,
-        match_pattern("[,| |\\n]"),
-        [&](lexer_context &lex) {
-            auto char_buffer = lex.char_buffer().str();
-            auto reg = get_register_id(char_buffer);
-
-            if(reg != std::nullopt) {
-                lex.push_token(token_type::REGISTER, reg.value());
-                lex.clear_char_buffer();
-            }
-            else {
-                return push_invalid_token("Invalid register")(lex);
+    static_transition<s::SEEK_REGISTER, s::BASE,
+        &match_class<comma_space_or_new_line>, &finish_register>,
+
+    static_transition<s::SEEK_REGISTER, s::INVALID_TOKEN,
+        &not_match_class<register_char>, &unexpected_char>,
+
+    static_transition<s::BASE, s::SEEK_LITERAL_STRING,
+        &match_class<double_quote>>,
+
+    static_transition<s::SEEK_LITERAL_STRING, s::SEEK_LITERAL_STRING,
+        &not_match_class<double_quote>, &consume_char>,
+
+    static_transition<s::SEEK_LITERAL_STRING, s::BASE,
+        &match_class<double_quote>, &finish_literal_string>,
+
+    static_transition<s::BASE, s::SEEK_LITERAL_CHAR,
+        &match_class<single_quote>>,
+
+    static_transition<s::SEEK_LITERAL_CHAR, s::SEEK_LITERAL_CHAR,
+        &not_match_class<single_quote>, &consume_char>,
+
+    static_transition<s::SEEK_LITERAL_CHAR, s::BASE,
+        &match_class<single_quote>, &finish_literal_char>,
+
+    static_transition<s::BASE, s::SEEK_LITERAL_NUMBER,
+        &match_class<number_start>, &consume_char>,
+
+    // hex and binary literals have letters in them, parse_number decides if it's valid
+    static_transition<s::SEEK_LITERAL_NUMBER, s::SEEK_LITERAL_NUMBER,
+        &match_class<alnum>, &consume_char>,
+
+    // delimited by "," or " " or "\n", i.e. .word 1, 2
+    static_transition<s::SEEK_LITERAL_NUMBER, s::BASE,
+        &match_class<comma_space_or_new_line>, &finish_literal_number>,
+
+    // IMM($reg)
+    //    ^
+    static_transition<s::SEEK_LITERAL_NUMBER, s::SEEK_IMM_REG_PRE,
+        &match_class<open_paren>, &finish_offset>,
+
+    static_transition<s::SEEK_LITERAL_NUMBER, s::INVALID_TOKEN,
+        &not_match_class<number_char>, &unexpected_char>,
+
+    static_transition<s::SEEK_IMM_REG_PRE, s::SEEK_IMM_REG,
+        &match_class<dollar>>,
+
+    static_transition<s::SEEK_IMM_REG, s::SEEK_IMM_REG,
+        &match_class<lower_alnum>, &consume_char>,
+
+    static_transition<s::SEEK_IMM_REG, s::BASE,
+        &match_class<close_paren>, &finish_base_register>,
+
+    // IMM(reg) or IMM($reg
+    //     ^             ^
+    static_transition<s::SEEK_IMM_REG_PRE, s::INVALID_TOKEN,
+        &not_match_class<dollar>, &unexpected_char>,
+
+    static_transition<s::SEEK_IMM_REG, s::INVALID_TOKEN,
+        &not_match_class<base_register_char>, &unexpected_char>,
+
+    // Some states loop on themselves for every character until a terminator,
+    // rather than ticking for each of them the machine skips to the terminator at once
+
+    // everything up to the newline is ignored
+    static_skip<s::SEEK_COMMENT, &skip_to_new_line>,
+    static_skip<s::INVALID_TOKEN, &skip_to_new_line>,
+
+    // everything up to the closing quote is consumed, newlines included
+    static_skip<s::SEEK_LITERAL_STRING, &skip_to_double_quote, &consume_span>,
+
+    // the rest of the identifier is consumed, the terminator decides what it is
+    static_skip<s::SEEK_LABEL_OR_MNEMONIC, &skip_identifier, &consume_span>
+
+    >;
+
+    using machine = basic_machine<no_profiling>;
+
+    // records where lexing spends its time, see lexer::lex with a profiler
+    using profiled_machine = basic_machine<profiler>;
+
+    /**
+     * @return The names of the states, for profiling reports
+     */
+    static std::vector<std::string> state_names() {
+        return {
+            "BASE", "SEEK_DIRECTIVE", "SEEK_LABEL_OR_MNEMONIC", "SEEK_COMMENT", "SEEK_REGISTER",
+            "SEEK_LITERAL_NUMBER", "SEEK_LITERAL_CHAR", "SEEK_LITERAL_STRING", "SEEK_IMM_REG_PRE",
+            "SEEK_IMM_REG", "INVALID_TOKEN"
+        };
+    }
+
+    /**
+     * Pass each character of a span of the source to the machine
+     * @param source The source offsets are taken relative to
+     * @param it     First character of the span
+     * @param end    End of the span
+     * @return false if an invalid token was found, lexing carries on from the next line regardless
+     */
+    template <typename Machine>
+    static bool run(Machine& machine, lexer_context& lex, const char* source, const char* it, const char* end) {
+        const std::size_t errors = lex.diagnostics().size();
+        std::size_t reported = errors;
+
+        auto feed = [source](lexer_context& lex, const char* it) {
+            lex.set_ch(*it, it - source);
+        };
+
+        auto resolve = [&reported](lexer_context& lex, states state) {
+            if(lex.diagnostics().size() == reported) {
+                return state;
             }
 
-            if(lex.ch() == ',') {
-                lex.push_token(token_type::COMMA);
+            reported = lex.diagnostics().size();
+            return resync(lex);
+        };
+
+        machine.run(lex, it, end, feed, resolve);
+
+        return reported == errors;
+    }
+
+    /**
+     * The newline is important, the lexer uses it to determine ends of comments, statements, etc...
+     * so this ends the last line of a source that doesn't
+     * @param pos Offset one past the end of the source
+     * @return false if an invalid token was found
+     */
+    template <typename Machine>
+    static bool end_line(Machine& machine, lexer_context& lex, std::size_t pos) {
+        const std::size_t errors = lex.diagnostics().size();
+
+        lex.set_ch('\n', pos);
+        machine.tick(lex);
+
+        if(lex.diagnostics().size() == errors) {
+            return true;
+        }
+
+        machine.set_state(resync(lex));
+        return false;
+    }
+
+    /**
+     * End the source, its last line is ended if it wasn't
+     * A literal can span lines but not the end of the source, if one is still open it is an invalid token
+     * @param pos       Offset one past the end of the source
+     * @param ends_line Whether the source ends with a newline
+     * @return false if an invalid token was found
+     */
+    template <typename Machine>
+    static bool end_source(Machine& machine, lexer_context& lex, std::size_t pos, bool ends_line) {
+        auto state = machine.get_state();
+
+        if(state == s::SEEK_LITERAL_STRING || state == s::SEEK_LITERAL_CHAR) {
+            lex.set_ch('\n', pos);
+            unterminated_literal(lex, state == s::SEEK_LITERAL_STRING ? "Unterminated string literal"
+                                                                     : "Unterminated character literal");
+
+            machine.set_state(resync(lex));
+            return false;
+        }
+
+        return ends_line || end_line(machine, lex, pos);
+    }
+
+    /**
+     * After an invalid token has replaced its statement, skip to the end of its line
+     * The newline still ends the statement, so the invalid token is a statement of its own
+     * @return The state the machine should carry on from
+     */
+    static states resync(lexer_context& lex) {
+        if(lex.ch() != '\n') {
+            return s::INVALID_TOKEN;
+        }
+
+        // the error was found by the newline itself
+        lex.push_token(token_type::NEW_LINE);
+
+        return s::BASE;
+    }
+
+    /**
+     * Lex all of the input with a machine, profiled or not, the body of lexer::lex
+     * @param diagnostics Has every error found in the input appended, located in the input
+     */
+    template <typename Machine>
+    static token_stream lex_source(Machine& machine, std::string_view input, std::vector<diagnostic>& diagnostics,
+                                   attribute_storage storage, interner* symbols) {
+        lexer_context lex(input, storage, symbols);
+
+        // pass each char to fsm, walking the input once
+        run(machine, lex, input.data(), input.data(), input.data() + input.size());
+
+        end_source(machine, lex, input.size(), input.back() == '\n');
+
+        auto errors = lex.take_diagnostics();
+        locate_diagnostics(input, errors);
+
+        diagnostics.insert(diagnostics.end(), std::make_move_iterator(errors.begin()),
+                           std::make_move_iterator(errors.end()));
+
+        return lex.take_tokens();
+    }
+
+    /**
+     * Lex the next statement, the lines up to the first that ends outside a literal
+     * It is lexed a line at a time, so the statement is ready to be handed out before the next is lexed
+     * @param pos Offset of the start of the statement, moved past its end
+     * @return false if an invalid token was found, it is then the statement
+     */
+    static bool run_statement(machine& machine, lexer_context& lex, std::string_view input, std::size_t& pos) {
+        const char* begin = input.data();
+        const char* end   = begin + input.size();
+
+        bool ok = true;
+
+        for(const char* it = begin + pos; it != end; ) {
+            auto new_line = static_cast<const char*>(std::memchr(it, '\n', end - it));
+            const char* line_end = new_line != nullptr ? new_line + 1 : end;
+
+            ok = run(machine, lex, begin, it, line_end) && ok;
+
+            if(line_end == end) {
+                ok = end_source(machine, lex, input.size(), input.back() == '\n') && ok;
             }
 
-            if(lex.ch() == '\n') {
-                lex.push_token(token_type::NEW_LINE);
+            pos = line_end - begin;
+
+            // a literal spanning lines is still open, so the statement continues on the next line
+            if(machine.get_state() == s::BASE) {
+                break;
             }
+
+            it = line_end;
         }
-    },
-
-    {
-        states::BASE, states::SEEK_LITERAL_STRING,
-        match_pattern("[\"]")
-    },
-
-    {
-        states::SEEK_LITERAL_STRING, states::SEEK_LITERAL_STRING,
-        not_match_pattern("[\"]"),
-        consume_char
-    },
-
-
-    {
-        states::SEEK_LITERAL_STRING, states::BASE,
-        match_pattern("[\"]"),
-        [&](lexer_context &lex) {
-            auto char_buffer = lex.char_buffer().str();
-            lex.push_token(token_type::LITERAL_STRING, char_buffer);
-            lex.clear_char_buffer();
+
+        return ok;
+    }
+
+    /**
+     * The tokens of a slice of the source, lexed on its own from BASE
+     */
+    struct slice {
+        token_stream tokens;
+
+        // the state after the last character, anything but BASE means the next slice started inside a token
+        states end_state = states::BASE;
+
+        // errors found in the slice, each has replaced its statement in tokens with an invalid token
+        std::vector<diagnostic> diagnostics;
+    };
+
+    /**
+     * Lex input[begin, end) as if it were the start of the source, the tokens' offsets are still into input
+     * @param symbols Interner for the slice's symbols, if any, it can't be shared by slices lexed at once
+     */
+    static slice lex_slice(std::string_view input, std::size_t begin, std::size_t end,
+                           attribute_storage storage, interner* symbols = nullptr) {
+        std::string_view source = input.substr(begin, end - begin);
+
+        lexer_context lex(source, storage, symbols);
+        machine machine(states::BASE);
+
+        lex.set_base(begin);
+
+        run(machine, lex, source.data(), source.data(), source.data() + source.size());
+
+        // only the end of the input might not end its line, or end inside a literal
+        if(end == input.size()) {
+            end_source(machine, lex, source.size(), source.back() == '\n');
         }
-    },
 
+        slice result;
+        result.end_state = machine.get_state();
+        result.tokens = lex.take_tokens();
+        result.diagnostics = lex.take_diagnostics();
+
+        return result;
+    }
+};
+
+std::optional<token_stream> lexer::lex(std::string_view input, attribute_storage storage,
+                                             interner* symbols) const {
 
-    {
-        states::BASE, states::SEEK_LITERAL_CHAR,
-        match_pattern("[']")
-    },
+    diagnostic_printer printer(std::cout);
+    return lex(input, printer, storage, symbols);
+}
 
-    {
-        states::SEEK_LITERAL_CHAR, states::SEEK_LITERAL_CHAR,
-        not_match_pattern("[']"),
-        consume_char
-    },
+std::optional<token_stream> lexer::lex(std::string_view input, diagnostic_sink& sink, attribute_storage storage,
+                                       interner* symbols) const {
 
+    if(input.empty()) return { };
 
-    {
-        states::SEEK_LITERAL_CHAR, states::BASE,
-        match_pattern("[']"),
-        [&](lexer_context &lex) {
-            auto char_buffer = lex.char_buffer().str();
+    std::vector<diagnostic> diagnostics;
+    auto tokens = lex(input, diagnostics, storage, symbols);
 
-            if(char_buffer.size() > 1) {
-                return push_invalid_token("Invalid character literal")(lex);
-            }
+    if(!diagnostics.empty()) {
+        report_diagnostics(sink, diagnostics);
+        return std::nullopt;
+    }
 
-            lex.push_token(token_type::LITERAL_CHAR, char_buffer);
-            lex.clear_char_buffer();
+    return tokens;
+}
+
+token_stream lexer::lex(std::string_view input, std::vector<diagnostic>& diagnostics, attribute_storage storage,
+                        interner* symbols) const {
+
+    if(input.empty() || source_too_large(input, diagnostics)) return { };
+
+    fsm::machine machine(states::BASE);
+    return fsm::lex_source(machine, input, diagnostics, storage, symbols);
+}
+
+std::optional<token_stream> lexer::lex(std::string_view input, profiler& profile, diagnostic_sink& sink,
+                                       attribute_storage storage, interner* symbols) const {
+
+    if(input.empty()) return { };
+
+    std::vector<diagnostic> diagnostics;
+
+    if(source_too_large(input, diagnostics)) {
+        report_diagnostics(sink, diagnostics);
+        return std::nullopt;
+    }
+
+    fsm::profiled_machine machine(states::BASE, profiler(fsm::state_names()));
+
+    auto tokens = fsm::lex_source(machine, input, diagnostics, storage, symbols);
+    profile = std::move(machine.profile());
+
+    if(!diagnostics.empty()) {
+        report_diagnostics(sink, diagnostics);
+        return std::nullopt;
+    }
+
+    return tokens;
+}
+
+std::optional<token_stream> lexer::lex_parallel(std::string_view input, diagnostic_sink& sink, unsigned threads,
+                                                attribute_storage storage, interner* symbols) const {
+    // below this, a thread isn't worth starting
+    constexpr std::size_t min_slice_size = 256 << 10;
+
+    if(threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    std::size_t slice_count = std::min<std::size_t>(threads, input.size() / min_slice_size);
+
+    // lex() rejects it
+    if(slice_count <= 1 || input.size() > max_source_size) {
+        return lex(input, sink, storage, symbols);
+    }
+
+    // cut the input into slices of about the same size, each ending on a newline
+    std::vector<std::size_t> bounds = { 0 };
+
+    for(std::size_t i = 1; i < slice_count; ++i) {
+        auto new_line = input.find('\n', std::max(input.size() * i / slice_count, bounds.back()));
+
+        if(new_line == std::string_view::npos || new_line + 1 >= input.size()) {
+            break;
         }
-    },
-
-
-    {
-        states::BASE, states::SEEK_LITERAL_NUMBER,
-        match_pattern("[\\-|0-9|\\+]"),
-        consume_char
-    },
-
-    {
-        states::SEEK_LITERAL_NUMBER, states::SEEK_LITERAL_NUMBER,
-        match_pattern("[0-9]"),
-        consume_char
-    },
-
-    {
-        states::SEEK_LITERAL_NUMBER, states::BASE,
-        match_pattern("[ |\\n]"),
-        [&](lexer_context &lex) {
-             auto char_buffer = lex.char_buffer().str();
-
-             try {
-                 int i_dec = std::stoi(char_buffer);
-                 lex.push_token(token_type::LITERAL_NUMBER,i_dec);
-                 lex.clear_char_buffer();
-             }
-             catch(const std::exception& e) {
-                return push_invalid_token("Invalid number literal")(lex);
-             }
-
-             if(lex.ch() == '\n') {
-                lex.push_token(token_type::NEW_LINE);
-             }
+
+        bounds.push_back(new_line + 1);
+    }
+
+    bounds.push_back(input.size());
+    slice_count = bounds.size() - 1;
+
+    // lex every slice at once, this thread takes the first
+    std::vector<fsm::slice> slices(slice_count);
+    std::vector<std::thread> workers;
+
+    auto lex_slice = [&](std::size_t i) {
+        slices[i] = fsm::lex_slice(input, bounds[i], bounds[i + 1], storage);
+    };
+
+    for(std::size_t i = 1; i < slice_count; ++i) {
+        workers.emplace_back(lex_slice, i);
+    }
+
+    lex_slice(0);
+
+    for(auto& worker : workers) {
+        worker.join();
+    }
+
+    // Join the slices in order
+    // A slice that didn't end in BASE ended inside a string or character literal that spans lines,
+    // so the next slice was lexed from the wrong state. The two are lexed again as one, which is rare
+    token_stream tokens;
+    std::size_t token_count = 0;
+
+    for(auto& slice : slices) {
+        token_count += slice.tokens.size();
+    }
+
+    tokens.reserve(token_count);
+
+    std::vector<diagnostic> diagnostics;
+
+    for(std::size_t i = 0; i < slice_count; ) {
+        std::size_t last = i;
+        fsm::slice joined = std::move(slices[i]);
+
+        while(joined.end_state != states::BASE && last + 1 < slice_count) {
+            ++last;
+            joined = fsm::lex_slice(input, bounds[i], bounds[last + 1], storage);
         }
-    },
-
-    {
-        states::SEEK_LITERAL_NUMBER, states::SEEK_IMM_REG_PRE,
-        match_pattern("[(]"),
-        [&](lexer_context &lex) {
-             auto char_buffer = lex.char_buffer().str();
-
-             try {
-                 int i_dec = std::stoi(char_buffer);
-                 lex.push_token(token_type::OFFSET, i_dec);
-             }
-             catch(const std::exception& e) {
-                return push_invalid_token("Invalid number literal")(lex);
-             }
+
+        // the joined slice started in BASE, so errors in it are real
+        diagnostics.insert(diagnostics.end(), joined.diagnostics.begin(), joined.diagnostics.end());
+
+        if(!diagnostics.empty()) {
+            i = last + 1;
+            continue;
         }
-    },
-
-    {
-        states::SEEK_IMM_REG_PRE, states::SEEK_IMM_REG,
-        match_pattern("[$]")
-    },
-
-    {
-        states::SEEK_IMM_REG, states::SEEK_IMM_REG,
-        match_pattern("[a-zA-Z]"),
-        consume_char
-    },
-
-    {
-        states::SEEK_IMM_REG, states::BASE,
-        match_pattern("[)]"),
-        [&](lexer_context &lex) {
-            auto char_buffer = lex.char_buffer().str();
-            auto reg = get_register_id(char_buffer);
-
-            if(reg != std::nullopt) {
-                lex.push_token(token_type::BASE_REGISTER, reg.value());
-                lex.clear_char_buffer();
-            } else {
-                return push_invalid_token("Invalid register")(lex);
+
+        // the interner can't be shared between the workers, so symbols are interned in order here
+        if(symbols != nullptr) {
+            for(std::size_t j = 0; j < joined.tokens.size(); ++j) {
+                if(is_symbol_token(joined.tokens.type(j))) {
+                    auto id = symbols->intern(joined.tokens.symbol(j));
+                    joined.tokens.set_interned_symbol(j, { id, symbols->name(id) });
+                }
             }
         }
+
+        tokens.append(std::move(joined.tokens));
+        i = last + 1;
     }
 
+    if(!diagnostics.empty()) {
+        locate_diagnostics(input, diagnostics);
+        report_diagnostics(sink, diagnostics);
+        return std::nullopt;
+    }
 
-    });
+    return tokens;
 }
 
-std::optional<std::vector<token>> lexer::lex(const std::string &input) {
+generator<token_stream> lexer::statements(std::string_view input, diagnostic_sink& sink,
+                                          attribute_storage storage, interner* symbols) const {
+    std::vector<diagnostic> too_large;
+
+    if(source_too_large(input, too_large)) {
+        report_diagnostics(sink, too_large);
+        co_return;
+    }
+
+    lexer_context lex(input, storage, symbols);
+    fsm::machine machine(states::BASE);
 
-    if(input == "") return { };
+    std::size_t pos = 0;
+    std::size_t reported = 0;
 
-    lexer_context lex;
+    // only scanned for its lines once there is an error to report
+    line_index lines(input);
 
-    // create a stringstream so we can read line by line below
-    std::stringstream ss(input);
-    std::size_t cur_line = 0;
-    std::string cur_line_str;
+    while(pos != input.size()) {
+        fsm::run_statement(machine, lex, input, pos);
 
-    // we tokenize line by line as it allow the lexer to tell us what
-    // errors happened on what line
-    while(std::getline(ss,cur_line_str,'\n')) {
+        for(; reported < lex.diagnostics().size(); ++reported) {
+            diagnostic error = lex.diagnostics()[reported];
+            locate_diagnostic(lines, error);
+            sink.report(std::move(error));
+        }
+
+        // lines without any tokens but their NEW_LINE aren't statements
+        if(lex.tokens().size() > 1) {
+            co_yield lex.tokens();
+        }
 
-        // add back the newline we removed, it's important
-        // the lexer uses it to determine ends of comments, statements, etc...
-        cur_line_str += '\n';
+        lex.clear_tokens();
+    }
+}
 
-        // tell lex current line
-        lex.set_cur_line(cur_line);
+bool lexer::relex(token_stream& tokens, std::string_view source, const line_edit& edit, diagnostic_sink& sink,
+                  attribute_storage storage, interner* symbols) const {
+    std::vector<diagnostic> too_large;
 
-        // pass each char to fsm
-        for(auto& ch : cur_line_str) {
-            lex.set_ch(ch);
-            m_fsm.tick(lex);
+    if(source_too_large(source, too_large)) {
+        report_diagnostics(sink, too_large);
+        return false;
+    }
 
-            // if an invalid token ever gets pushed
-            if(!lex.tokens().empty() &&
-                    lex.tokens().end()->type() == token_type::INVALID_TOKEN) {
+    // the source before the edit hasn't changed, so the changed lines start at the same offset as they did
+    std::size_t edit_begin = skip_lines(source, edit.first_line);
 
-                // display the error string in the invalid_token token attribute
-                std::cout << std::get<std::string>(lex.tokens().end()->attribute()) << std::endl;
-                return std::nullopt;
-            };
+    // Every newline outside a literal ends its line with a NEW_LINE token, so the FSM is in BASE after it
+    // and a line only starts inside a literal if the token before its first isn't a NEW_LINE
+    std::size_t first = tokens.lower_bound_offset(static_cast<std::uint32_t>(edit_begin));
+
+    while(first > 0 && tokens.type(first - 1) != token_type::NEW_LINE) {
+        --first;
+    }
+
+    std::size_t begin = first == 0 ? 0 : tokens.offset(first - 1) + 1;
+
+    // Find the old tokens that are kept after the edit by counting the old lines off the tokens,
+    // each newline was either a NEW_LINE or inside a literal. If the edit ended inside a literal they can't be kept
+    std::size_t lines = count_new_lines(source.substr(begin, edit_begin - begin)) + edit.removed_lines;
+    std::size_t last = first;
+    bool rest_reusable = true;
+
+    for(; lines > 0 && last < tokens.size(); ++last) {
+        auto type = tokens.type(last);
+
+        if(type == token_type::NEW_LINE) {
+            --lines;
+        } else if(type == token_type::LITERAL_STRING || type == token_type::LITERAL_CHAR) {
+            auto literal = tokens.symbol(last);
+            auto spanned = static_cast<std::size_t>(std::count(literal.begin(), literal.end(), '\n'));
+
+            if(spanned >= lines) {
+                rest_reusable = false;
+                break;
+            }
+
+            lines -= spanned;
         }
+    }
+
+    std::size_t old_end = last == first ? begin : tokens.offset(last - 1) + 1;
 
-        cur_line++;
+    // find where the lines to lex end in the new source
+    std::size_t end = skip_lines(source, edit.inserted_lines, edit_begin);
+
+    fsm::slice lexed = begin < end ? fsm::lex_slice(source, begin, end, storage, symbols)
+                                   : fsm::slice();
+
+    // the edit opened or closed a literal spanning lines, so everything after it changes too
+    if(lexed.diagnostics.empty() && (lexed.end_state != states::BASE || !rest_reusable)) {
+        last = tokens.size();
+        lexed = begin < source.size() ? fsm::lex_slice(source, begin, source.size(), storage, symbols)
+                                      : fsm::slice();
     }
 
-    return lex.tokens();
-};
+    if(!lexed.diagnostics.empty()) {
+        locate_diagnostics(source, lexed.diagnostics);
+        report_diagnostics(sink, lexed.diagnostics);
+        return false;
+    }
+
+    auto offset_shift = static_cast<std::ptrdiff_t>(end) - static_cast<std::ptrdiff_t>(old_end);
+    tokens.splice(first, last, std::move(lexed.tokens), offset_shift);
+
+    return true;
+}
+
+lexer::stream::stream(token_callback callback, diagnostic_sink& sink, attribute_storage storage, interner* symbols,
+                      std::size_t base) :
+    m_callback(std::move(callback)),
+    m_sink(sink),
+    m_context({ }, storage, symbols),
+    m_state(states::BASE),
+    m_fed(base),
+    m_line_begin(base)
+{
+    m_context.set_base(base);
+}
+
+bool lexer::stream::feed(std::string_view chunk) {
+    // tokens are flushed every this many bytes, so a large chunk doesn't buffer all of its tokens
+    constexpr std::size_t flush_interval = 64 << 10;
+
+    if(m_failed) return false;
+    if(chunk.empty()) return true;
+
+    // the offsets of its tokens would wrap
+    if(m_fed > max_source_size || chunk.size() > max_source_size - m_fed) {
+        auto at = std::min(m_fed, max_source_size);
+
+        m_sink.report({ static_cast<std::uint32_t>(at), m_lines, at - std::min(m_line_begin, at), too_large_reason });
+        m_failed = true;
+        return false;
+    }
+
+    fsm::machine machine(m_state);
+    m_context.set_source(chunk);
+
+    const char* begin = chunk.data();
+    const char* end   = begin + chunk.size();
+
+    for(const char* it = begin; it != end; ) {
+        const char* stop = end - it > static_cast<std::ptrdiff_t>(flush_interval) ? it + flush_interval : end;
+
+        if(!fsm::run(machine, m_context, begin, it, stop)) {
+            report_errors(chunk);
+            m_failed = true;
+            return false;
+        }
+
+        flush();
+        it = stop;
+    }
+
+    m_state = machine.get_state();
+    m_at_line_start = chunk.back() == '\n';
+
+    // keep count of the lines fed so far, errors in later chunks are shown with their line
+    auto last_new_line = chunk.rfind('\n');
 
-}
\ No newline at end of file
+    if(last_new_line != std::string_view::npos) {
+        m_lines += count_new_lines(chunk);
+        m_line_begin = m_fed + last_new_line + 1;
+    }
+
+    m_fed += chunk.size();
+
+    // the chunk is gone after this returns, so copy out a lexeme that continues into the next
+    m_context.set_source({ });
+
+    return true;
+}
+
+bool lexer::stream::finish() {
+    if(m_failed) return false;
+
+    fsm::machine machine(m_state);
+
+    if(!fsm::end_source(machine, m_context, 0, m_at_line_start)) {
+        report_errors({ });
+        m_failed = true;
+        return false;
+    }
+
+    m_state = machine.get_state();
+    m_at_line_start = true;
+
+    flush();
+    return true;
+}
+
+void lexer::stream::flush() {
+    m_context.flush_tokens(m_callback);
+}
+
+void lexer::stream::report_errors(std::string_view chunk) const {
+    line_index lines(chunk);
+
+    for(diagnostic error : m_context.diagnostics()) {
+        // an error in a lexeme carried over from a previous chunk is put on the line the chunk started on
+        if(error.offset >= m_fed) {
+            auto location = lines.locate(static_cast<std::uint32_t>(error.offset - m_fed));
+
+            error.line   = m_lines + location.line;
+            error.column = location.line == 0 ? error.offset - m_line_begin : location.column;
+        } else {
+            error.line   = m_lines;
+            error.column = error.offset >= m_line_begin ? error.offset - m_line_begin : 0;
+        }
+
+        m_sink.report(error);
+    }
+}
+
+}
@@ -0,0 +1,48 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#include "lexer/line_index.hpp"
+
+#include <algorithm>
+#include "lexer/scan.hpp"
+
+namespace as {
+
+namespace {
+
+constexpr byte_ranges new_line_ranges = { {'\n', '\n'} };
+
+}
+
+source_location line_index::locate(std::uint32_t offset) {
+    build();
+
+    // the last line starting at or before the offset
+    auto line = std::upper_bound(m_starts.begin(), m_starts.end(), offset) - m_starts.begin() - 1;
+
+    return { static_cast<std::size_t>(line), offset - m_starts[line] };
+}
+
+std::size_t line_index::lines() {
+    build();
+    return m_starts.size();
+}
+
+void line_index::build() {
+    if(!m_starts.empty()) {
+        return;
+    }
+
+    const char* begin = m_source.data();
+    const char* end   = begin + m_source.size();
+
+    m_starts.push_back(0);
+
+    for(const char* it = find_first_in(begin, end, new_line_ranges); it != end;
+            it = find_first_in(it + 1, end, new_line_ranges)) {
+        m_starts.push_back(static_cast<std::uint32_t>(it + 1 - begin));
+    }
+}
+
+}
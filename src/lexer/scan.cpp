@@ -0,0 +1,192 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#include "lexer/scan.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MIPS_ASM_SCAN_X86
+#include <immintrin.h>
+#endif
+
+namespace as {
+
+namespace {
+
+// negate selects between looking for bytes in the ranges, or bytes outside of them
+using scan_func = const char* (*)(const char*, const char*, const byte_ranges&, bool);
+
+const char* scan_scalar(const char* begin, const char* end, const byte_ranges& ranges, bool negate) {
+    for(; begin != end; ++begin) {
+        if(ranges.contains(*begin) != negate) {
+            return begin;
+        }
+    }
+
+    return end;
+}
+
+#ifdef MIPS_ASM_SCAN_X86
+
+// A byte x is in [first, last] when (x - first) <= (last - first) as unsigned,
+// the saturating subtract of the width is zero exactly when that holds
+
+__attribute__((target("sse2")))
+const char* scan_sse2(const char* begin, const char* end, const byte_ranges& ranges, bool negate) {
+    const __m128i zero = _mm_setzero_si128();
+
+    __m128i firsts[byte_ranges::max_ranges];
+    __m128i widths[byte_ranges::max_ranges];
+
+    for(std::size_t i = 0; i < ranges.size(); ++i) {
+        firsts[i] = _mm_set1_epi8(ranges[i].first);
+        widths[i] = _mm_set1_epi8(static_cast<char>(ranges[i].last - ranges[i].first));
+    }
+
+    for(; end - begin >= 16; begin += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        __m128i in = zero;
+
+        for(std::size_t i = 0; i < ranges.size(); ++i) {
+            __m128i offset = _mm_subs_epu8(_mm_sub_epi8(block, firsts[i]), widths[i]);
+            in = _mm_or_si128(in, _mm_cmpeq_epi8(offset, zero));
+        }
+
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(in));
+
+        if(negate) {
+            mask = ~mask & 0xFFFFu;
+        }
+
+        if(mask != 0) {
+            return begin + __builtin_ctz(mask);
+        }
+    }
+
+    return scan_scalar(begin, end, ranges, negate);
+}
+
+__attribute__((target("avx2")))
+const char* scan_avx2(const char* begin, const char* end, const byte_ranges& ranges, bool negate) {
+    // too short for a single block
+    if(end - begin < 32) {
+        return scan_sse2(begin, end, ranges, negate);
+    }
+
+    const __m256i zero = _mm256_setzero_si256();
+
+    __m256i firsts[byte_ranges::max_ranges];
+    __m256i widths[byte_ranges::max_ranges];
+
+    for(std::size_t i = 0; i < ranges.size(); ++i) {
+        firsts[i] = _mm256_set1_epi8(ranges[i].first);
+        widths[i] = _mm256_set1_epi8(static_cast<char>(ranges[i].last - ranges[i].first));
+    }
+
+    for(; end - begin >= 32; begin += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+        __m256i in = zero;
+
+        for(std::size_t i = 0; i < ranges.size(); ++i) {
+            __m256i offset = _mm256_subs_epu8(_mm256_sub_epi8(block, firsts[i]), widths[i]);
+            in = _mm256_or_si256(in, _mm256_cmpeq_epi8(offset, zero));
+        }
+
+        auto mask = static_cast<unsigned>(_mm256_movemask_epi8(in));
+
+        if(negate) {
+            mask = ~mask;
+        }
+
+        if(mask != 0) {
+            return begin + __builtin_ctz(mask);
+        }
+    }
+
+    // scan_sse2 isn't VEX encoded, running it with the upper halves of the ymm registers dirty
+    // stalls on every SSE instruction, which costs hundreds of cycles on short spans
+    _mm256_zeroupper();
+
+    return scan_sse2(begin, end, ranges, negate);
+}
+
+#endif
+
+scan_func scan_for(scan_isa isa) {
+    switch(isa) {
+#ifdef MIPS_ASM_SCAN_X86
+        case scan_isa::AVX2:
+            return scan_avx2;
+
+        case scan_isa::SSE2:
+            return scan_sse2;
+#endif
+        default:
+            return scan_scalar;
+    }
+}
+
+// the best instruction set available, detected through cpuid
+scan_isa detect_scan_isa() {
+#ifdef MIPS_ASM_SCAN_X86
+    __builtin_cpu_init();
+#endif
+
+    if(scan_isa_supported(scan_isa::AVX2)) {
+        return scan_isa::AVX2;
+    }
+
+    if(scan_isa_supported(scan_isa::SSE2)) {
+        return scan_isa::SSE2;
+    }
+
+    return scan_isa::SCALAR;
+}
+
+// detected on first use, so scanning is safe during static initialization of other translation units
+const scan_func& active_scan() {
+    static const scan_func func = scan_for(active_scan_isa());
+    return func;
+}
+
+}
+
+scan_isa active_scan_isa() {
+    static const scan_isa isa = detect_scan_isa();
+    return isa;
+}
+
+bool scan_isa_supported(scan_isa isa) {
+    switch(isa) {
+#ifdef MIPS_ASM_SCAN_X86
+        case scan_isa::AVX2:
+            return __builtin_cpu_supports("avx2");
+
+        case scan_isa::SSE2:
+            return __builtin_cpu_supports("sse2");
+#endif
+        case scan_isa::SCALAR:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+const char* find_first_in(const char* begin, const char* end, const byte_ranges& ranges) {
+    return active_scan()(begin, end, ranges, false);
+}
+
+const char* find_first_not_in(const char* begin, const char* end, const byte_ranges& ranges) {
+    return active_scan()(begin, end, ranges, true);
+}
+
+const char* find_first_in(const char* begin, const char* end, const byte_ranges& ranges, scan_isa isa) {
+    return scan_for(isa)(begin, end, ranges, false);
+}
+
+const char* find_first_not_in(const char* begin, const char* end, const byte_ranges& ranges, scan_isa isa) {
+    return scan_for(isa)(begin, end, ranges, true);
+}
+
+}
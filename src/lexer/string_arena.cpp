@@ -0,0 +1,68 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include "lexer/string_arena.hpp"
+
+namespace as {
+
+std::string_view string_arena::store(std::string_view str) {
+    if(str.empty()) {
+        return { };
+    }
+
+    // strings too large for a block get one of their own
+    if(m_blocks.empty() || m_block_used + str.size() > block_size) {
+        m_blocks.emplace_back(new char[std::max(str.size(), block_size)]);
+        m_block_used = 0;
+    }
+
+    char* dest = m_blocks.back().get() + m_block_used;
+    std::memcpy(dest, str.data(), str.size());
+
+    // an oversized block is full
+    m_block_used = std::min(m_block_used + str.size(), block_size);
+    m_stored += str.size();
+
+    return { dest, str.size() };
+}
+
+void string_arena::adopt(string_arena&& other) {
+    if(other.m_blocks.empty()) {
+        return;
+    }
+
+    // the other arena's last block becomes the one that is filled next
+    m_blocks.insert(m_blocks.end(),
+                    std::make_move_iterator(other.m_blocks.begin()),
+                    std::make_move_iterator(other.m_blocks.end()));
+    m_block_used = other.m_block_used;
+    m_stored += other.m_stored;
+
+    other.m_blocks.clear();
+    other.m_block_used = 0;
+    other.m_stored = 0;
+}
+
+void string_arena::clear() {
+    // the first block is kept, so an arena that is filled and cleared over and over doesn't allocate each time
+    if(m_blocks.size() > 1) {
+        m_blocks.resize(1);
+    }
+
+    m_block_used = 0;
+    m_stored = 0;
+}
+
+bool string_arena::owns(const char* str) const {
+    // a string is stored at most block_size into a block, an oversized one at its start
+    return std::any_of(m_blocks.begin(), m_blocks.end(), [str](const std::unique_ptr<char[]>& block) {
+        return !std::less<const char*>()(str, block.get()) && std::less<const char*>()(str, block.get() + block_size);
+    });
+}
+
+}
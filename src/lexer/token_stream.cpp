@@ -0,0 +1,202 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#include "lexer/token_stream.hpp"
+
+#include <algorithm>
+#include "lexer/scan.hpp"
+
+namespace as {
+
+namespace {
+
+// Replace values[first, last) with another array, only moving the values after them if the sizes differ
+template <typename T>
+void replace_range(std::vector<T>& values, std::size_t first, std::size_t last, const std::vector<T>& with) {
+    std::size_t common = std::min(last - first, with.size());
+
+    std::copy(with.begin(), with.begin() + common, values.begin() + first);
+
+    if(with.size() > common) {
+        values.insert(values.begin() + first + common, with.begin() + common, with.end());
+    } else {
+        values.erase(values.begin() + first + common, values.begin() + last);
+    }
+}
+
+}
+
+void token_stream::push_back(const token& tk) {
+    if(!tk.has_symbol()) {
+        return push_number(tk.type(), tk.offset(), tk.number());
+    }
+
+    if(tk.owns_symbol()) {
+        return push_owned_symbol(tk.type(), tk.offset(), tk.symbol());
+    }
+
+    push_symbol(tk.type(), tk.offset(), tk.symbol(), tk.symbol_id().value_or(no_id));
+}
+
+std::size_t token_stream::symbol_index(std::size_t index) const {
+    for(; index < size(); ++index) {
+        if(m_types[index] & symbol_flag) {
+            return m_values[index];
+        }
+    }
+
+    return m_symbols.size();
+}
+
+void token_stream::compact() {
+    string_arena arena;
+
+    for(auto& sym : m_symbols) {
+        if(m_arena.owns(sym.data)) {
+            sym.data = arena.store({ sym.data, sym.size }).data();
+        }
+    }
+
+    m_arena = std::move(arena);
+    m_garbage = 0;
+}
+
+void token_stream::append(token_stream&& other) {
+    auto symbol_base = static_cast<std::uint32_t>(m_symbols.size());
+
+    m_types.insert(m_types.end(), other.m_types.begin(), other.m_types.end());
+    m_offsets.insert(m_offsets.end(), other.m_offsets.begin(), other.m_offsets.end());
+
+    // symbol indices move up past the symbols already here
+    m_values.reserve(m_values.size() + other.m_values.size());
+
+    for(std::size_t i = 0; i < other.size(); ++i) {
+        bool is_symbol = other.m_types[i] & symbol_flag;
+        m_values.push_back(is_symbol ? other.m_values[i] + symbol_base : other.m_values[i]);
+    }
+
+    m_symbols.insert(m_symbols.end(), other.m_symbols.begin(), other.m_symbols.end());
+    m_arena.adopt(std::move(other.m_arena));
+    m_garbage += other.m_garbage;
+
+    other.clear();
+}
+
+void token_stream::splice(std::size_t first, std::size_t last, token_stream&& replacement,
+                          std::ptrdiff_t offset_shift) {
+    // the pool is in token order, so the removed tokens' symbols are a range of it
+    auto symbols_first = symbol_index(first);
+    auto symbols_last  = symbol_index(last);
+
+    // their owned copies are garbage in the arena until it is compacted
+    for(auto i = symbols_first; i < symbols_last; ++i) {
+        if(m_arena.owns(m_symbols[i].data)) {
+            m_garbage += m_symbols[i].size;
+        }
+    }
+
+    // the replacement's symbols take their place, moving the symbols after them
+    auto symbol_shift = static_cast<std::ptrdiff_t>(replacement.m_symbols.size()) -
+                        static_cast<std::ptrdiff_t>(symbols_last - symbols_first);
+
+    if(offset_shift != 0 || symbol_shift != 0) {
+        for(std::size_t i = last; i < size(); ++i) {
+            m_offsets[i] = static_cast<std::uint32_t>(m_offsets[i] + offset_shift);
+
+            if(m_types[i] & symbol_flag) {
+                m_values[i] = static_cast<std::uint32_t>(m_values[i] + symbol_shift);
+            }
+        }
+    }
+
+    for(std::size_t i = 0; i < replacement.size(); ++i) {
+        if(replacement.m_types[i] & symbol_flag) {
+            replacement.m_values[i] += static_cast<std::uint32_t>(symbols_first);
+        }
+    }
+
+    // the replacement is usually a few lines, so its owned symbols are copied rather than adopting its blocks
+    for(auto& sym : replacement.m_symbols) {
+        if(replacement.m_arena.owns(sym.data)) {
+            sym.data = m_arena.store({ sym.data, sym.size }).data();
+        }
+    }
+
+    replace_range(m_types, first, last, replacement.m_types);
+    replace_range(m_offsets, first, last, replacement.m_offsets);
+    replace_range(m_values, first, last, replacement.m_values);
+    replace_range(m_symbols, symbols_first, symbols_last, replacement.m_symbols);
+
+    // copying the owned symbols once there is more garbage than symbols keeps it linear in the edits
+    if(m_garbage * 2 > m_arena.size()) {
+        compact();
+    }
+
+    replacement.clear();
+}
+
+token token_stream::at(std::size_t index) const {
+    auto tk_type = type(index);
+    auto offset = m_offsets[index];
+
+    if((m_types[index] & symbol_flag) == 0) {
+        return token(tk_type, offset, static_cast<std::int32_t>(m_values[index]));
+    }
+
+    auto& sym = m_symbols[m_values[index]];
+    std::string_view name(sym.data, sym.size);
+
+    if(sym.id != no_id) {
+        return token::interned(tk_type, offset, { sym.id, name });
+    }
+
+    return token::borrowing(tk_type, offset, name);
+}
+
+std::size_t token_stream::find(token_type type, std::size_t from) const {
+    if(from >= size()) {
+        return size();
+    }
+
+    auto plain  = static_cast<char>(static_cast<std::uint8_t>(type));
+    auto symbol = static_cast<char>(static_cast<std::uint8_t>(type) | symbol_flag);
+
+    byte_ranges types = { { plain, plain }, { symbol, symbol } };
+
+    auto begin = reinterpret_cast<const char*>(m_types.data());
+    auto end   = begin + m_types.size();
+
+    return find_first_in(begin + from, end, types) - begin;
+}
+
+std::size_t token_stream::lower_bound_offset(std::uint32_t offset) const {
+    return std::lower_bound(m_offsets.begin(), m_offsets.end(), offset) - m_offsets.begin();
+}
+
+void token_stream::reserve(std::size_t count) {
+    m_types.reserve(count);
+    m_offsets.reserve(count);
+    m_values.reserve(count);
+}
+
+void token_stream::clear() {
+    m_types.clear();
+    m_offsets.clear();
+    m_values.clear();
+    m_symbols.clear();
+    m_arena.clear();
+    m_garbage = 0;
+}
+
+void token_stream::pop_back() {
+    if((m_types.back() & symbol_flag) && m_values.back() == m_symbols.size() - 1) {
+        m_symbols.pop_back();
+    }
+
+    m_types.pop_back();
+    m_offsets.pop_back();
+    m_values.pop_back();
+}
+
+}
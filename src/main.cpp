@@ -1,41 +1,96 @@
-#include <iostream>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
-#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
 
+#include "io/mapped_file.hpp"
 #include "lexer/lexer.hpp"
 #include "emitter/emitter.hpp"
 
-int main()
+namespace {
+
+// Write an assembled binary, false if it couldn't be
+bool write_binary(const std::string& path, const std::vector<std::uint8_t>& binary) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+
+    if(!out) {
+        std::cerr << "could not open " << path << " for writing" << std::endl;
+        return false;
+    }
+
+    out.write(reinterpret_cast<const char*>(binary.data()), static_cast<std::streamsize>(binary.size()));
+
+    if(!out) {
+        std::cerr << "could not write " << path << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+}
+
+// usage: mips_asm [-o <output>] <file.s>...
+// each file is assembled to <file.s>.bin, unless -o names the output of a single file
+int main(int argc, char* argv[])
 {
-    // Open assembly file
-    std::fstream file("test.s", std::ios::in);
+    const char* output = nullptr;
+    int first = 1;
+
+    if(argc > 2 && std::strcmp(argv[1], "-o") == 0) {
+        output = argv[2];
+        first = 3;
+    }
+
+    if(first >= argc || (output != nullptr && argc - first > 1)) {
+        std::cerr << "usage: " << argv[0] << " [-o <output>] <file.s>..." << std::endl;
+        std::cerr << "       -o can only be given with one file" << std::endl;
+        return 1;
+    }
+
+    int result = 0;
 
+    for(int i = first; i < argc; ++i) {
+        std::string path = output != nullptr ? output : std::string(argv[i]) + ".bin";
 
-    // Seek to end to get size
-    file.seekg(0, std::ios_base::end);
-    auto size = file.tellg();
+        // Map the assembly file, the lexer reads it in place
+        auto file = as::mapped_file::open(argv[i]);
 
-    // Seek back to beginning
-    file.seekg(0, std::ios_base::beg);
+        if(!file.has_value()) {
+            std::cerr << "could not open " << argv[i] << std::endl;
+            result = 1;
+            continue;
+        }
 
-    // Create our input buffer
-    std::string input;
-    input.resize(size);
+        // nothing to assemble, the binary is empty
+        if(file.value().contents().empty()) {
+            if(!write_binary(path, { })) {
+                result = 1;
+            }
+            continue;
+        }
 
-    file.read(&input[0],size);
+        as::lexer lexer;
+        as::interner symbols;
+        as::diagnostic_printer printer(std::cout, file.value().contents());
 
-    // replace tabs with correct whitespace
-    // as our lexer does not expect tabs
-    std::replace(input.begin(),input.end(),'\t',' ');
+        // the mapping outlives the tokens, so they can reference it rather than copying strings,
+        // labels, mnemonics and directives are interned
+        auto tokens = lexer.lex(file.value().contents(), printer, as::attribute_storage::BORROWED, &symbols);
 
-    as::lexer test;
+        if(!tokens.has_value()) {
+            result = 1;
+            continue;
+        }
 
-    auto tokens = test.lex(input);
+        auto binary = as::emit(tokens.value(), &printer);
 
-    if(tokens.has_value()) {
-        as::emitter emitter;
-        auto binary = emitter.emit(tokens.value());
+        if(!binary.has_value() || !write_binary(path, binary.value())) {
+            result = 1;
+        }
     }
 
-    return 0;
-}
\ No newline at end of file
+    return result;
+}
@@ -2,39 +2,30 @@
 // Created by ocanty on 09/02/19.
 //
 
+#include <array>
+#include <iterator>
 #include "spec/instruction_defs.hpp"
+#include "spec/perfect_hash.hpp"
 
 namespace as::spec {
 
-instruction_def::instruction_def(const instruction_def_format& idf,
-    const operand_def_format& odf,
-    const std::uint8_t& upper_field,
-    const std::uint8_t& lower_field) :
-    m_ins_format(idf),
-    m_operand_fmt(odf),
-    m_upper_field(upper_field),
-    m_lower_field(lower_field) {
-
-};
-
-instruction_def::instruction_def(const instruction_def_format& idf,
-    const operand_def_format& odf,
-    const std::uint8_t& upper_field) :
-    m_ins_format(idf),
-    m_operand_fmt(odf),
-    m_upper_field(upper_field) {
-
-};
-
-const instruction_def_format& instruction_def::instruction_format() {
+const instruction_def_format& instruction_def::instruction_format() const {
     return m_ins_format;
 }
 
-const operand_def_format & instruction_def::operand_format() {
+const operand_def_format & instruction_def::operand_format() const {
     return m_operand_fmt;
 }
 
-const std::unordered_map<std::string, instruction_def> instructions::instruction_defs = {
+namespace {
+
+struct instruction_entry {
+    std::string_view mnemonic;
+    instruction_def def;
+};
+
+// an instruction's id is its index in this table
+constexpr instruction_entry instruction_table[] = {
     // Format Operand-format upper_field, lower_field
     {"add",   {R, RD_RS_RT,       0x00, 0x20}},
     {"addi",  {I, RT_RS_IMM,      0x08}},
@@ -93,8 +84,55 @@ const std::unordered_map<std::string, instruction_def> instructions::instruction
     {"sub",   {R, RD_RS_RT,       0x00, 0x22}},
     {"subu",  {R, RD_RS_RT,       0x00, 0x23}},
     {"sw",    {I, RT_OFFSET_BASE, 0b101011}},
-    {"swl",   {I, RT_OFFSET_BASE, 0b101010}},
     {"swl",   {I, RT_OFFSET_BASE, 0b101010}}
 };
 
+constexpr std::size_t instruction_count = std::size(instruction_table);
+
+constexpr std::array<std::string_view, instruction_count> mnemonics = [] {
+    std::array<std::string_view, instruction_count> names = { };
+
+    for(std::size_t i = 0; i < instruction_count; ++i) {
+        names[i] = instruction_table[i].mnemonic;
+    }
+
+    return names;
+}();
+
+constexpr perfect_hash<instruction_count> mnemonic_hash(mnemonics);
+
+}
+
+std::optional<std::uint8_t> instructions::id(std::string_view mnemonic) {
+    auto id = mnemonic_hash.find(mnemonic);
+
+    if(id.has_value()) {
+        return static_cast<std::uint8_t>(id.value());
+    }
+
+    return std::nullopt;
+}
+
+const instruction_def* instructions::find(std::string_view mnemonic) {
+    auto id = mnemonic_hash.find(mnemonic);
+
+    if(id.has_value()) {
+        return &instruction_table[id.value()].def;
+    }
+
+    return nullptr;
+}
+
+const instruction_def& instructions::at(std::uint8_t id) {
+    return instruction_table[id].def;
+}
+
+std::string_view instructions::mnemonic(std::uint8_t id) {
+    return instruction_table[id].mnemonic;
+}
+
+std::size_t instructions::count() {
+    return instruction_count;
+}
+
 }
\ No newline at end of file
@@ -5,6 +5,9 @@
 #include <emitter/emitter.hpp>
 
 #include "emitter/encode.hpp"
+#include "emitter/encoding_plan.hpp"
+#include "emitter/op_sequences.hpp"
+#include "lexer/lexer.hpp"
 #include "lexer/token.hpp"
 #include "lexer/token_type.hpp"
 
@@ -41,16 +44,36 @@ TEST_CASE("Emitter encoding - J type", "[emitter]" ) {
     using tk = as::token_type;
     WHEN("j <label>") {
         auto output = as::encode_instruction({
-            { tk::MNEMONIC, 0, "sub" },
+            { tk::MNEMONIC, 0, "j" },
             { tk::LABEL, 0, "ayy"}
         }, { {"ayy", 0x2c} });
 
         THEN("Correct J encoding") {
             REQUIRE(output.has_value());
-            REQUIRE(output.value() == 0x01094022);
+            REQUIRE(output.value() == 0x0800000B);
         };
 
     }
+
+    WHEN("j <label> with an interned label") {
+        as::interner symbols;
+        as::lexer lexer;
+
+        auto tokens = lexer.lex("j ayy\n", as::attribute_storage::OWNED, &symbols);
+        tokens.value().pop_back();
+
+        std::vector<as::token> statement(tokens.value().begin(), tokens.value().end());
+
+        std::vector<std::optional<std::uint32_t>> label_addresses(symbols.size());
+        label_addresses.at(symbols.find("ayy").value()) = 0x2c;
+
+        auto output = as::encode_interned_instruction(statement, label_addresses);
+
+        THEN("Correct J encoding") {
+            REQUIRE(output.has_value());
+            REQUIRE(output.value() == 0x0800000B);
+        };
+    }
 }
 
 TEST_CASE("Emitter encoding - I type", "[emitter]" ) {
@@ -72,4 +95,370 @@ TEST_CASE("Emitter encoding - I type", "[emitter]" ) {
 
     }
 }
+
+TEST_CASE("Operation sequences are found by signature", "[emitter]" ) {
+    using tk = as::token_type;
+
+    WHEN("Looking up the signature of each sequence") {
+        THEN("The first sequence with those token types is found") {
+            for(auto& sequence : as::op_sequences::all()) {
+                auto found = as::op_sequences::find(as::op_signature::of(sequence.token_types()));
+
+                REQUIRE(found != nullptr);
+                REQUIRE(found->token_types() == sequence.token_types());
+            }
+        };
+    }
+
+    WHEN("Looking up a sequence that is a prefix of another") {
+        auto found = as::op_sequences::find(as::op_signature::of(std::vector<tk>{ tk::MNEMONIC, tk::REGISTER, tk::COMMA }));
+
+        THEN("Nothing is found") {
+            REQUIRE(found == nullptr);
+        };
+    }
+
+    WHEN("Looking up a sequence longer than a signature holds") {
+        std::vector<tk> types(as::op_signature::max_types + 1, tk::REGISTER);
+        types.front() = tk::MNEMONIC;
+
+        THEN("Nothing is found") {
+            REQUIRE(as::op_sequences::find(as::op_signature::of(types)) == nullptr);
+        };
+    }
+}
+
+TEST_CASE("Encoding plans place each operand", "[emitter]" ) {
+    using tk = as::token_type;
+    auto& three_registers = *as::op_sequences::find(as::op_signature::of(std::vector<tk>{
+        tk::MNEMONIC, tk::REGISTER, tk::COMMA, tk::REGISTER, tk::COMMA, tk::REGISTER
+    }));
+
+    WHEN("add is planned with three registers") {
+        auto plan = as::encoding_plan::find(as::spec::instructions::id("add").value(), three_registers);
+
+        THEN("Each register has a field, and the function is in the base") {
+            REQUIRE(plan != nullptr);
+            REQUIRE(plan->base() == 0x20);
+            REQUIRE(plan->end() - plan->begin() == 3);
+        };
+
+        THEN("A register out of range isn't encoded") {
+            std::int32_t registers[] = { 0, 8, 0, 32, 0, 9 };
+            auto no_label = [](std::size_t) { return std::optional<std::uint32_t>(); };
+
+            REQUIRE_FALSE(plan->encode(0, [&](std::size_t i) { return registers[i]; }, no_label).has_value());
+
+            registers[3] = 31;
+            REQUIRE(plan->encode(0, [&](std::size_t i) { return registers[i]; }, no_label).has_value());
+        };
+    }
+
+    WHEN("j is planned with three registers") {
+        auto plan = as::encoding_plan::find(as::spec::instructions::id("j").value(), three_registers);
+
+        THEN("There is no plan") {
+            REQUIRE(plan == nullptr);
+        };
+    }
+}
+
+TEST_CASE("Emitter reports why an instruction wasn't encoded", "[emitter]" ) {
+    using tk = as::token_type;
+
+    WHEN("The mnemonic isn't an instruction") {
+        as::diagnostic_list sink;
+        auto output = as::encode_instruction({
+            { tk::MNEMONIC, 12, "nop" },
+        }, { }, &sink);
+
+        THEN("An error is reported at the mnemonic") {
+            REQUIRE_FALSE(output.has_value());
+            REQUIRE(sink.diagnostics().size() == 1);
+            REQUIRE(sink.diagnostics()[0].level == as::severity::ERROR);
+            REQUIRE(sink.diagnostics()[0].offset == 12);
+            REQUIRE(sink.diagnostics()[0].reason == "Invalid mnemonic nop");
+        };
+    }
+
+    WHEN("A shift amount doesn't fit") {
+        as::diagnostic_list sink(as::severity::TRACE);
+        auto output = as::encode_instruction({
+            { tk::MNEMONIC,       0, "sll" },
+            { tk::REGISTER,       4, 8 },
+            { tk::COMMA,          7, 0 },
+            { tk::REGISTER,       9, 9 },
+            { tk::COMMA,          12, 0 },
+            { tk::LITERAL_NUMBER, 14, 33 }
+        }, { }, &sink);
+
+        THEN("It is masked with a warning at the operand") {
+            REQUIRE(output.has_value());
+            REQUIRE(((output.value() >> 6) & 0b11111) == 1);
+
+            REQUIRE(sink.diagnostics().at(0).level == as::severity::WARNING);
+            REQUIRE(sink.diagnostics().at(0).offset == 14);
+            REQUIRE_FALSE(sink.has_errors());
+        };
+
+        THEN("The encoding is traced unless traces are compiled out") {
+            REQUIRE(sink.diagnostics().size() == (as::trace_enabled ? 2 : 1));
+        };
+    }
+}
+
+TEST_CASE("Emitter assembles text and data", "[emitter]" ) {
+    as::lexer lexer;
+
+    auto assemble = [&lexer](const std::string& source, as::diagnostic_sink* sink = nullptr) {
+        return as::emit(lexer.lex(source).value(), sink);
+    };
+
+    WHEN("Labels are used before and after they're defined") {
+        auto binary = assemble(
+            ".text\n"
+            "main: j end\n"
+            "add $t0, $t1, $t2\n"
+            "end: j main\n"
+            ".data\n"
+            "msg: .asciiz \"h\\n\"\n"
+            "address: .word msg, end\n"
+            ".byte 'a', 98\n");
+
+        THEN("Each is patched with its address, data is placed after the text") {
+            REQUIRE(binary.has_value());
+            REQUIRE(binary.value() == std::vector<std::uint8_t>{
+                0x08, 0x10, 0x00, 0x3E, // j end,  end is at 0x4000f8
+                0x01, 0x2A, 0x40, 0x20, // add $t0, $t1, $t2
+                0x08, 0x10, 0x00, 0x3C, // j main, main is at 0x4000f0
+                'h', '\n', 0x00, 0x00,  // msg, padded for the word
+                0x00, 0x40, 0x00, 0xFC, // msg is at 0x4000fc
+                0x00, 0x40, 0x00, 0xF8,
+                'a', 'b'
+            });
+        };
+    }
+
+    WHEN("Loading from an offset of a base register") {
+        auto binary = assemble("lw $t1, 4($sp)\n");
+
+        THEN("The base is encoded as rs") {
+            REQUIRE(binary.has_value());
+            REQUIRE(binary.value() == std::vector<std::uint8_t>{ 0x8F, 0xA9, 0x00, 0x04 });
+        };
+    }
+
+    WHEN("Branching back and forward to labels") {
+        auto binary = assemble(
+            "loop: addi $t0, $t0, -1\n"
+            "bne $t0, $zero, loop\n"
+            "beq $t0,$t1,done\n"
+            "blez $t0, loop\n"
+            "add $t0, $t1, $t2\n"
+            "done: j loop\n");
+
+        THEN("Each is the number of words from the instruction after the branch") {
+            REQUIRE(binary.has_value());
+            REQUIRE(binary.value() == std::vector<std::uint8_t>{
+                0x21, 0x08, 0xFF, 0xFF, // addi $t0, $t0, -1
+                0x15, 0x00, 0xFF, 0xFE, // bne $t0, $zero, loop, -2 words
+                0x11, 0x09, 0x00, 0x02, // beq $t0, $t1, done, +2 words
+                0x19, 0x00, 0xFF, 0xFC, // blez $t0, loop, -4 words
+                0x01, 0x2A, 0x40, 0x20, // add $t0, $t1, $t2
+                0x08, 0x10, 0x00, 0x3C  // j loop
+            });
+            REQUIRE(as::emit_parallel(lexer.lex(
+                "loop: addi $t0, $t0, -1\nbne $t0, $zero, loop\nbeq $t0,$t1,done\nblez $t0, loop\n"
+                "add $t0, $t1, $t2\ndone: j loop\n").value(), 2) == binary);
+        };
+    }
+
+    WHEN("A branch is too far from its label") {
+        std::string source = "beq $t0, $t1, far\n";
+
+        for(std::size_t i = 0; i < 32768; ++i) {
+            source += "add $t0, $t1, $t2\n";
+        }
+
+        source += "far: bne $t0, $t1, near\nnear: j far\n";
+
+        as::diagnostic_list sink;
+        auto binary = assemble(source, &sink);
+
+        THEN("It is reported at the label") {
+            REQUIRE_FALSE(binary.has_value());
+            REQUIRE(sink.diagnostics().size() == 1);
+            REQUIRE(sink.diagnostics()[0].offset == 14);
+            REQUIRE(sink.diagnostics()[0].reason == as::branch_out_of_range);
+        };
+
+        THEN("One word closer it fits") {
+            source.erase(source.find("add $t0, $t1, $t2\n"), 18);
+            REQUIRE(assemble(source).has_value());
+        };
+    }
+
+    WHEN("Loading from a label") {
+        auto binary = assemble(
+            "lw $t0, msg\n"
+            "sw $t1, neg\n"
+            ".data\n"
+            "msg: .word 7\n"
+            ".space 32760\n"
+            "neg: .word 0\n");
+
+        THEN("The address is split between lui $at and the load's offset") {
+            REQUIRE(binary.has_value());
+            REQUIRE(std::vector<std::uint8_t>(binary.value().begin(), binary.value().begin() + 16) == std::vector<std::uint8_t>{
+                0x3C, 0x01, 0x00, 0x40, // lui $at, 0x40
+                0x8C, 0x28, 0x01, 0x00, // lw $t0, 0x100($at), msg is at 0x400100
+                0x3C, 0x01, 0x00, 0x41, // lui $at, 0x41, the offset is negative
+                0xAC, 0x29, 0x80, 0xFC  // sw $t1, -0x7F04($at), neg is at 0x4080FC
+            });
+            REQUIRE(as::emit_parallel(lexer.lex(
+                "lw $t0, msg\nsw $t1, neg\n.data\nmsg: .word 7\n.space 32760\nneg: .word 0\n").value(), 2) == binary);
+        };
+    }
+
+    WHEN("A label is never defined") {
+        as::diagnostic_list sink;
+        auto binary = assemble("j main\nj nowhere\n", &sink);
+
+        THEN("Each undefined label is reported where it's first used") {
+            REQUIRE_FALSE(binary.has_value());
+            REQUIRE(sink.diagnostics().size() == 2);
+            REQUIRE(sink.diagnostics()[0].reason == "Undefined label main");
+            REQUIRE(sink.diagnostics()[1].offset == 9);
+        };
+    }
+
+    WHEN("An instruction is in the data section") {
+        as::diagnostic_list sink;
+        auto binary = assemble(".data\nadd $t0, $t1, $t2\n.half x\n", &sink);
+
+        THEN("Both errors are reported") {
+            REQUIRE_FALSE(binary.has_value());
+            REQUIRE(sink.diagnostics().size() == 2);
+            REQUIRE(sink.diagnostics()[0].offset == 6);
+        };
+    }
+
+    WHEN("A directive has no values, or a negative size") {
+        for(const std::string source : { ".data\n.word\n", ".data\n.half\n", ".data\n.byte\n",
+                                         ".data\n.space -5\n" }) {
+            as::diagnostic_list sink;
+
+            REQUIRE_FALSE(assemble(source, &sink).has_value());
+            REQUIRE(sink.diagnostics().size() == 1);
+        }
+
+        as::diagnostic_list sink;
+        assemble(".data\n.space -5\n", &sink);
+
+        REQUIRE(sink.diagnostics()[0].offset == 13);
+        REQUIRE(sink.diagnostics()[0].reason == "Space size can't be negative");
+        REQUIRE(assemble(".data\n.space 0\n").value().empty());
+    }
+
+    WHEN("An immediate doesn't fit in 16 bits") {
+        for(const std::string source : { "addi $t0, $t0, 65536\n", "ori $t0, $t0, -32769\n", "lw $t0, 65536($sp)\n" }) {
+            as::diagnostic_list sink;
+
+            REQUIRE_FALSE(assemble(source, &sink).has_value());
+            REQUIRE(sink.diagnostics().size() == 1);
+            REQUIRE(sink.diagnostics()[0].reason == "Immediate out of range (-32768 <= x <= 65535)");
+            REQUIRE(sink.diagnostics()[0].offset == source.find_last_of(',') + 2);
+            REQUIRE_FALSE(as::emit_parallel(lexer.lex(source).value(), 2).has_value());
+        }
+
+        THEN("Either sign of 16 bits fits") {
+            REQUIRE(assemble("addi $t0, $t0, -32768\nori $t0, $t0, 0xFFFF\n").value() == std::vector<std::uint8_t>{
+                0x21, 0x08, 0x80, 0x00,
+                0x35, 0x08, 0xFF, 0xFF
+            });
+        };
+    }
+
+    WHEN("Labels were interned while lexing") {
+        const std::string source = "main: j end\nend: j main\n.data\n.word end\n";
+        as::interner symbols;
+        auto tokens = lexer.lex(source, as::attribute_storage::OWNED, &symbols).value();
+
+        THEN("They're the same labels as by name") {
+            REQUIRE(tokens.symbol_id(0).has_value());
+            REQUIRE(as::emit(tokens) == assemble(source));
+        };
+
+        THEN("A token of the same name without an id is the same label") {
+            as::token_stream mixed;
+            mixed.push_back(as::token(as::token_type::LABEL_DEFINITION, 0, "main"));
+
+            for(std::size_t i = 1; i < tokens.size(); ++i) {
+                mixed.push_back(tokens.at(i));
+            }
+
+            REQUIRE_FALSE(mixed.symbol_id(0).has_value());
+            REQUIRE(as::emit(mixed) == assemble(source));
+        };
+    }
+
+    WHEN("Statements are pulled from the lexer") {
+        const std::string source = "main: j main\n.data\n.word main\n";
+        as::diagnostic_list sink;
+        auto binary = as::emit(lexer.statements(source, sink), &sink);
+
+        THEN("The binary is the same as from all the tokens") {
+            REQUIRE(binary.has_value());
+            REQUIRE(binary == assemble(source));
+        };
+    }
+}
+
+TEST_CASE("Emitter encodes instructions in parallel", "[emitter]" ) {
+    as::lexer lexer;
+    std::string source = ".data\nvalues: .word start, 1, 2\n.text\nstart:\n";
+
+    for(std::size_t i = 0; i < 20000; ++i) {
+        source += "add $t0, $t1, $t2\naddi $t0, $t0, 100\nlw $t1, 4($sp)\nj next" + std::to_string(i) + "\n";
+        source += "lw $t2, values\nbeq $t0, $t1, next" + std::to_string(i) + "\n";
+        source += "next" + std::to_string(i) + ": sub $s0, $s1, $s2\nj start\n";
+    }
+
+    auto tokens = lexer.lex(source).value();
+    auto expected = as::emit(tokens);
+
+    REQUIRE(expected.has_value());
+
+    WHEN("Encoding with any number of threads") {
+        THEN("The binary is the same as emit's") {
+            for(unsigned threads : { 1, 2, 3, 7 }) {
+                REQUIRE(as::emit_parallel(tokens, threads) == expected);
+            }
+        };
+    }
+
+    WHEN("There are errors in several chunks") {
+        source += "add $t0, foo\nj nowhere\n";
+        source.replace(source.find("addi $t0, $t0, 100"), 4, "ad  ");
+        source.replace(source.rfind("lw $t1"), 2, "lx");
+
+        auto broken = lexer.lex(source).value();
+
+        as::diagnostic_list in_order;
+        as::emit(broken, &in_order);
+
+        THEN("They are reported in the order they appear") {
+            for(unsigned threads : { 1, 3 }) {
+                as::diagnostic_list merged;
+
+                REQUIRE_FALSE(as::emit_parallel(broken, threads, &merged).has_value());
+                REQUIRE(merged.diagnostics().size() == 4);
+
+                for(std::size_t i = 0; i < merged.diagnostics().size(); ++i) {
+                    REQUIRE(merged.diagnostics()[i].offset == in_order.diagnostics()[i].offset);
+                    REQUIRE(merged.diagnostics()[i].reason == in_order.diagnostics()[i].reason);
+                }
+            }
+        };
+    }
 }
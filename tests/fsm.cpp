@@ -0,0 +1,383 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#include <sstream>
+#include <string>
+#include <catch.hpp>
+#include "fsm/finite_state_machine.hpp"
+#include "fsm/static_finite_state_machine.hpp"
+
+namespace {
+
+enum class turnstile {
+    LOCKED,
+    UNLOCKED
+};
+
+struct coin_input {
+    char input;
+    int coins = 0;
+};
+
+template <template <typename, typename> class Table, typename Profiler>
+void add_turnstile_transitions(as::finite_state_machine<turnstile, coin_input, Table, Profiler>& fsm) {
+    fsm.add_transitions({
+        {
+            turnstile::LOCKED, turnstile::UNLOCKED,
+            [](coin_input& in) { return in.input == 'c'; },
+            [](coin_input& in) { in.coins++; }
+        },
+        // added later, but still tested after the transition above
+        {
+            turnstile::UNLOCKED, turnstile::LOCKED,
+            [](coin_input& in) { return in.input == 'p'; }
+        },
+        {
+            turnstile::LOCKED, turnstile::LOCKED,
+            [](coin_input&) { return true; }
+        },
+    });
+}
+
+bool is_coin(coin_input& in) {
+    return in.input == 'c';
+}
+
+bool is_push(coin_input& in) {
+    return in.input == 'p';
+}
+
+void count_coin(coin_input& in) {
+    in.coins++;
+}
+
+using static_turnstile = as::static_finite_state_machine<turnstile, coin_input,
+    as::static_transition<turnstile::LOCKED, turnstile::UNLOCKED, &is_coin, &count_coin>,
+    as::static_transition<turnstile::UNLOCKED, turnstile::LOCKED, &is_push>
+>;
+
+}
+
+TEST_CASE("Finite state machine ticks", "[fsm]") {
+    coin_input in;
+
+    WHEN("Dense transition table") {
+        as::finite_state_machine<turnstile, coin_input> fsm(turnstile::LOCKED);
+        add_turnstile_transitions(fsm);
+
+        THEN("Transitions are tested in the order they were added") {
+            in.input = 'c';
+            REQUIRE(fsm.tick(in) == turnstile::UNLOCKED);
+            REQUIRE(in.coins == 1);
+
+            in.input = 'c';
+            REQUIRE(fsm.tick(in) == turnstile::UNLOCKED);
+
+            in.input = 'p';
+            REQUIRE(fsm.tick(in) == turnstile::LOCKED);
+
+            in.input = 'p';
+            REQUIRE(fsm.tick(in) == turnstile::LOCKED);
+            REQUIRE(in.coins == 1);
+        }
+    }
+
+    WHEN("Map transition table") {
+        as::finite_state_machine<turnstile, coin_input, as::transition_table> fsm(turnstile::LOCKED);
+        add_turnstile_transitions(fsm);
+
+        THEN("Behaves the same as the dense table") {
+            in.input = 'c';
+            REQUIRE(fsm.tick(in) == turnstile::UNLOCKED);
+
+            in.input = 'p';
+            REQUIRE(fsm.tick(in) == turnstile::LOCKED);
+            REQUIRE(in.coins == 1);
+        }
+    }
+}
+
+TEST_CASE("Static finite state machine ticks", "[fsm]") {
+    coin_input in;
+    static_turnstile fsm(turnstile::LOCKED);
+
+    THEN("Transitions fire and callbacks run") {
+        in.input = 'c';
+        REQUIRE(fsm.tick(in) == turnstile::UNLOCKED);
+        REQUIRE(in.coins == 1);
+
+        in.input = 'p';
+        REQUIRE(fsm.tick(in) == turnstile::LOCKED);
+    }
+
+    THEN("No transition available stays in the current state") {
+        in.input = 'p';
+        REQUIRE(fsm.tick(in) == turnstile::LOCKED);
+        REQUIRE(in.coins == 0);
+    }
+    THEN("A state past the last one with transitions stays where it is") {
+        as::static_finite_state_machine<turnstile, coin_input,
+            as::static_transition<turnstile::LOCKED, turnstile::UNLOCKED, &is_coin, &count_coin>
+        > one_way(turnstile::LOCKED);
+
+        in.input = 'c';
+        REQUIRE(one_way.tick(in) == turnstile::UNLOCKED);
+        REQUIRE(one_way.tick(in) == turnstile::UNLOCKED);
+        REQUIRE(in.coins == 1);
+    }
+}
+
+namespace {
+
+// a scanner whose comments last until a newline, each tick is counted so skipped bytes can be told apart
+enum class comment_state {
+    CODE,
+    COMMENT
+};
+
+struct comment_input {
+    char ch;
+    int ticks = 0;
+    std::string skipped;
+};
+
+bool is_hash(comment_input& in) {
+    return ++in.ticks, in.ch == '#';
+}
+
+bool is_new_line(comment_input& in) {
+    return ++in.ticks, in.ch == '\n';
+}
+
+void keep_skipped(comment_input& in, const char* begin, const char* end) {
+    in.skipped.append(begin, end);
+}
+
+using static_comments = as::static_finite_state_machine<comment_state, comment_input,
+    as::static_transition<comment_state::CODE, comment_state::COMMENT, &is_hash>,
+    as::static_transition<comment_state::COMMENT, comment_state::CODE, &is_new_line>,
+    as::static_skip<comment_state::COMMENT, &as::skip_to<'\n'>, &keep_skipped>
+>;
+
+void feed_char(comment_input& in, const char* it) {
+    in.ch = *it;
+}
+
+bool is_letter(char ch) {
+    return ch >= 'a' && ch <= 'z';
+}
+
+}
+
+TEST_CASE("Finite state machines skip runs of input", "[fsm]") {
+    const std::string input = "ab#comment\ncd#x\n";
+    const char* begin = input.data();
+    const char* end   = begin + input.size();
+
+    comment_input in;
+
+    WHEN("Static finite state machine") {
+        static_comments fsm(comment_state::CODE);
+
+        THEN("The comments are skipped rather than ticked") {
+            REQUIRE(fsm.run(in, begin, end, &feed_char) == comment_state::CODE);
+
+            // everything but the comment text is ticked
+            REQUIRE(in.ticks == 8);
+            REQUIRE(in.skipped == "commentx");
+        }
+
+        THEN("A run can stop inside a skip and carry on") {
+            REQUIRE(fsm.run(in, begin, begin + 5, &feed_char) == comment_state::COMMENT);
+            REQUIRE(fsm.run(in, begin + 5, end, &feed_char) == comment_state::CODE);
+            REQUIRE(in.skipped == "commentx");
+        }
+
+        THEN("The state can be changed after each tick") {
+            auto resolve = [](comment_input& in, comment_state state) {
+                return in.ch == '#' ? comment_state::CODE : state;
+            };
+
+            REQUIRE(fsm.run(in, begin, end, &feed_char, resolve) == comment_state::CODE);
+            REQUIRE(in.ticks == static_cast<int>(input.size()));
+            REQUIRE(in.skipped.empty());
+        }
+    }
+
+    WHEN("Runtime finite state machine") {
+        as::finite_state_machine<comment_state, comment_input> fsm(comment_state::CODE);
+
+        fsm.add_transitions({
+            { comment_state::CODE, comment_state::COMMENT, is_hash },
+            { comment_state::COMMENT, comment_state::CODE, is_new_line }
+        });
+
+        fsm.add_skip(comment_state::COMMENT, &as::skip_to<'\n'>, keep_skipped);
+
+        THEN("The comments are skipped rather than ticked") {
+            REQUIRE(fsm.run(in, begin, end, &feed_char) == comment_state::CODE);
+            REQUIRE(in.ticks == 8);
+            REQUIRE(in.skipped == "commentx");
+        }
+    }
+
+    THEN("Scanners stop at a terminator, or while a predicate holds") {
+        REQUIRE(as::skip_to<'\n'>(begin, end) == begin + 10);
+        REQUIRE(as::skip_to<'#', '\n'>(begin, end) == begin + 2);
+        REQUIRE(as::skip_to<'z'>(begin, end) == end);
+
+        REQUIRE(as::skip_while<&is_letter>(begin, end) == begin + 2);
+    }
+}
+
+namespace {
+
+using profiled_turnstile = as::profiled_static_finite_state_machine<turnstile, coin_input,
+    as::static_transition<turnstile::LOCKED, turnstile::UNLOCKED, &is_coin, &count_coin>,
+    as::static_transition<turnstile::UNLOCKED, turnstile::LOCKED, &is_push>
+>;
+
+bool is_anything(coin_input&) {
+    return true;
+}
+
+// a push and anything else both leave a locked turnstile locked, the skip isn't a transition
+using profiled_pushed_turnstile = as::profiled_static_finite_state_machine<turnstile, coin_input,
+    as::static_transition<turnstile::LOCKED, turnstile::UNLOCKED, &is_coin, &count_coin>,
+    as::static_transition<turnstile::LOCKED, turnstile::LOCKED, &is_push>,
+    as::static_skip<turnstile::UNLOCKED, &as::skip_to<'p'>>,
+    as::static_transition<turnstile::LOCKED, turnstile::LOCKED, &is_anything>,
+    as::static_transition<turnstile::UNLOCKED, turnstile::LOCKED, &is_push>
+>;
+
+}
+
+TEST_CASE("Finite state machines can be profiled", "[fsm]") {
+    coin_input in;
+
+    auto feed = [](coin_input& in, char ch) {
+        in.input = ch;
+    };
+
+    THEN("Machines that aren't profiled take no space for it") {
+        REQUIRE(sizeof(static_turnstile) == sizeof(turnstile));
+    }
+
+    WHEN("Static finite state machine") {
+        profiled_turnstile fsm(turnstile::LOCKED, as::profiler({ "LOCKED", "UNLOCKED" }));
+
+        for(char ch : std::string("cpcpp")) {
+            feed(in, ch);
+            fsm.tick(in);
+        }
+
+        auto& profile = fsm.profile();
+
+        THEN("Ticks, fallbacks and transitions are counted per state") {
+            REQUIRE(profile.states().size() == 2);
+            REQUIRE(profile.states()[0].ticks == 3);
+            REQUIRE(profile.states()[0].no_transitions == 1);
+            REQUIRE(profile.states()[1].ticks == 2);
+            REQUIRE(profile.states()[1].no_transitions == 0);
+
+            auto transitions = profile.transitions();
+            REQUIRE(transitions.size() == 2);
+            REQUIRE(transitions[0].from == 0);
+            REQUIRE(transitions[0].to == 1);
+            REQUIRE(transitions[0].fired == 2);
+        }
+
+        THEN("The reports name the states") {
+            std::ostringstream text, json, dot;
+
+            profile.write_text(text);
+            profile.write_json(json);
+            profile.write_dot(dot);
+
+            REQUIRE(text.str().find("LOCKED -> UNLOCKED") != std::string::npos);
+            REQUIRE(json.str().find("{\"from\":\"LOCKED\",\"to\":\"UNLOCKED\",\"fired\":2}") != std::string::npos);
+            REQUIRE(dot.str().find("\"LOCKED\" -> \"UNLOCKED\" [label=\"2\"];") != std::string::npos);
+        }
+
+        THEN("Resetting forgets the counts but not the transitions") {
+            fsm.profile().reset();
+            REQUIRE(profile.states().empty());
+            REQUIRE(profile.transitions().size() == 2);
+            REQUIRE(profile.transitions()[0].fired == 0);
+        }
+    }
+
+    WHEN("Static finite state machine with transitions between the same states") {
+        profiled_pushed_turnstile fsm(turnstile::LOCKED, as::profiler({ "LOCKED", "UNLOCKED" }));
+
+        for(char ch : std::string("ppxcp")) {
+            feed(in, ch);
+            fsm.tick(in);
+        }
+
+        auto& transitions = fsm.profile().transitions();
+
+        THEN("Each transition is counted apart, numbered in declaration order") {
+            REQUIRE(transitions.size() == 4);
+            REQUIRE(transitions[1].from == 0);
+            REQUIRE(transitions[1].to == 0);
+            REQUIRE(transitions[1].fired == 2);
+            REQUIRE(transitions[2].from == 0);
+            REQUIRE(transitions[2].to == 0);
+            REQUIRE(transitions[2].fired == 1);
+            REQUIRE(transitions[3].from == 1);
+            REQUIRE(transitions[3].fired == 1);
+        }
+
+        THEN("The graph has every transition, those that never fired are dashed") {
+            fsm.profile().reset();
+
+            std::ostringstream dot;
+            fsm.profile().write_dot(dot);
+
+            auto dashed = std::string("\"LOCKED\" -> \"LOCKED\" [label=\"0\", style=dashed];");
+            auto first = dot.str().find(dashed);
+
+            REQUIRE(first != std::string::npos);
+            REQUIRE(dot.str().find(dashed, first + 1) != std::string::npos);
+        }
+    }
+
+    WHEN("Runtime finite state machine") {
+        as::finite_state_machine<turnstile, coin_input, as::dense_transition_table, as::profiler> fsm(turnstile::LOCKED);
+        add_turnstile_transitions(fsm);
+
+        for(char ch : std::string("cpx")) {
+            feed(in, ch);
+            fsm.tick(in);
+        }
+
+        THEN("Ticks and transitions are counted per state, unnamed states are numbered") {
+            REQUIRE(fsm.profile().states()[0].ticks == 2);
+            REQUIRE(fsm.profile().transitions().size() == 3);
+            REQUIRE(fsm.profile().transitions()[2].fired == 1);
+            REQUIRE(fsm.profile().state_name(1) == "1");
+        }
+    }
+
+    WHEN("Runs of input are skipped") {
+        as::profiled_static_finite_state_machine<comment_state, comment_input,
+            as::static_transition<comment_state::CODE, comment_state::COMMENT, &is_hash>,
+            as::static_transition<comment_state::COMMENT, comment_state::CODE, &is_new_line>,
+            as::static_skip<comment_state::COMMENT, &as::skip_to<'\n'>>
+        > fsm(comment_state::CODE);
+
+        const std::string input = "ab#comment\ncd#x\n";
+        comment_input comments;
+
+        fsm.run(comments, input.data(), input.data() + input.size(), &feed_char);
+
+        THEN("The skips and the bytes skipped are counted") {
+            auto& comment = fsm.profile().states()[1];
+            REQUIRE(comment.skips == 2);
+            REQUIRE(comment.skipped_bytes == 8);
+            REQUIRE(comment.ticks == 2);
+        }
+    }
+}
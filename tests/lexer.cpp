@@ -2,9 +2,18 @@
 // Created by ocanty on 13/03/19.
 //
 
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 #include <catch.hpp>
+#include "lexer/diagnostic.hpp"
+#include "lexer/diagnostic_sink.hpp"
 #include "lexer/lexer.hpp"
+#include "lexer/line_index.hpp"
 #include "lexer/token_type.hpp"
+#include "lexer/scan.hpp"
 
 TEST_CASE("Lexer lexes", "[lexer]" ) {
 
@@ -36,4 +45,1020 @@ TEST_CASE("Lexer lexes", "[lexer]" ) {
         }
 
     }
+
+    WHEN("Registers, commas and a comment") {
+        auto output = lexer.lex("add $t0, $t1, $t2 # comment, with $ymbols\n");
+
+        THEN("Comment is skipped") {
+            REQUIRE(output.has_value());
+            REQUIRE(output.value().size() == 7);
+            REQUIRE(output.value().at(1).type() == tk::REGISTER);
+            REQUIRE(output.value().at(2).type() == tk::COMMA);
+            REQUIRE(output.value().at(6).type() == tk::NEW_LINE);
+        }
+
+        THEN("Registers are resolved by name") {
+            REQUIRE(std::get<std::int32_t>(output.value().at(1).attribute()) == 8);
+            REQUIRE(std::get<std::int32_t>(output.value().at(5).attribute()) == 10);
+        }
+    }
+}
+
+TEST_CASE("Lexer skips long comments and strings", "[lexer]") {
+    using tk = as::token_type;
+
+    as::lexer lexer;
+    std::string text(100, 'x');
+    auto output = lexer.lex("# " + text + ", $\n.asciiz \"" + text + " # ,\" long_label_name_over_32_characters:\n");
+
+    REQUIRE(output.has_value());
+    REQUIRE(output.value().size() == 5);
+    REQUIRE(output.value().at(0).type() == tk::NEW_LINE);
+    REQUIRE(std::get<std::string>(output.value().at(2).attribute()) == text + " # ,");
+    REQUIRE(std::get<std::string>(output.value().at(3).attribute()) == "long_label_name_over_32_characters");
+}
+
+TEST_CASE("Scanning finds the same byte on every instruction set", "[lexer]") {
+    using namespace as;
+
+    constexpr byte_ranges ident = { {'a', 'z'}, {'A', 'Z'}, {'0', '9'}, {'_', '_'} };
+    constexpr byte_ranges quote = { {'"', '"'} };
+
+    std::string input;
+    for(int i = 0; i < 200; ++i) {
+        input += static_cast<char>((i * 37) % 256);
+    }
+
+    for(auto isa : { scan_isa::SCALAR, scan_isa::SSE2, scan_isa::AVX2 }) {
+        if(!scan_isa_supported(isa)) {
+            continue;
+        }
+
+        for(std::size_t start = 0; start < input.size(); ++start) {
+            auto begin = input.data() + start;
+            auto end = input.data() + input.size();
+
+            REQUIRE(find_first_in(begin, end, quote, isa) == find_first_in(begin, end, quote, scan_isa::SCALAR));
+            REQUIRE(find_first_not_in(begin, end, ident, isa) == find_first_not_in(begin, end, ident, scan_isa::SCALAR));
+        }
+    }
+
+    // a fifth range isn't dropped
+    REQUIRE_THROWS_AS(byte_ranges({ {'a', 'z'}, {'A', 'Z'}, {'0', '9'}, {'_', '_'}, {'$', '$'} }), std::length_error);
+}
+
+TEST_CASE("Lexer can reference the source instead of copying", "[lexer]") {
+    using tk = as::token_type;
+
+    as::lexer lexer;
+    const std::string input = "main:\nj main\n.asciiz \"text\"\n";
+    auto output = lexer.lex(input, as::attribute_storage::BORROWED);
+
+    REQUIRE(output.has_value());
+
+    auto& tokens = output.value();
+    REQUIRE(tokens.at(0).type() == tk::LABEL_DEFINITION);
+    REQUIRE(tokens.at(0).symbol() == "main");
+    REQUIRE(tokens.at(0).symbol().data() == input.data());
+
+    REQUIRE(tokens.at(3).symbol() == "main");
+    REQUIRE(tokens.at(3).symbol().data() == input.data() + 8);
+
+    THEN("Attributes can still be materialized") {
+        REQUIRE(std::get<std::string>(tokens.at(6).attribute()) == "text");
+    }
+}
+
+TEST_CASE("Lexer records where each token starts", "[lexer]") {
+    using tk = as::token_type;
+
+    as::lexer lexer;
+    std::string_view input = "add\n\n.asciiz \"two\nlines\"\nsub";
+    auto output = lexer.lex(input);
+
+    REQUIRE(output.has_value());
+
+    auto& tokens = output.value();
+    REQUIRE(tokens.size() == 8);
+
+    THEN("Tokens carry the offset of their first character, or of the newline ending the input") {
+        std::vector<std::uint32_t> offsets;
+
+        for(std::size_t i = 0; i < tokens.size(); ++i) {
+            offsets.push_back(tokens.offset(i));
+        }
+
+        REQUIRE(offsets == std::vector<std::uint32_t>{ 0, 3, 4, 6, 14, 24, 25, 28 });
+        REQUIRE(tokens.at(6).offset() == 25);
+    }
+
+    THEN("Offsets are resolved to lines and columns") {
+        as::line_index lines(input);
+
+        REQUIRE(lines.lines() == 5);
+
+        auto string = lines.locate(tokens.offset(4));
+        REQUIRE(string.line == 2);
+        REQUIRE(string.column == 9);
+
+        auto new_line = lines.locate(tokens.offset(5));
+        REQUIRE(new_line.line == 3);
+        REQUIRE(new_line.column == 6);
+
+        auto sub = lines.locate(tokens.offset(6));
+        REQUIRE(sub.line == 4);
+        REQUIRE(sub.column == 0);
+    }
+
+    THEN("The last line is ended without a trailing newline") {
+        REQUIRE(tokens.at(6).type() == tk::MNEMONIC);
+        REQUIRE(tokens.at(7).type() == tk::NEW_LINE);
+    }
+}
+
+TEST_CASE("Lexer ends numbers and labels at commas", "[lexer]") {
+    using tk = as::token_type;
+
+    as::lexer lexer;
+    auto output = lexer.lex(".word 1, main,2\n");
+
+    REQUIRE(output.has_value());
+
+    std::vector<as::token_type> types;
+
+    for(std::size_t i = 0; i < output.value().size(); ++i) {
+        types.push_back(output.value().type(i));
+    }
+
+    REQUIRE(types == std::vector<as::token_type>{
+        tk::DIRECTIVE, tk::LITERAL_NUMBER, tk::COMMA, tk::LABEL, tk::COMMA, tk::LITERAL_NUMBER, tk::NEW_LINE
+    });
+}
+
+TEST_CASE("Line index resolves offsets to lines and columns", "[lexer]") {
+    // lines of every length up to past a vector width, so newlines fall everywhere within a block
+    std::string source;
+    std::vector<std::uint32_t> starts;
+
+    for(std::size_t length = 0; length < 70; ++length) {
+        starts.push_back(static_cast<std::uint32_t>(source.size()));
+        source += std::string(length, 'x') + "\n";
+    }
+
+    as::line_index lines(source);
+    REQUIRE(lines.lines() == starts.size() + 1);
+
+    for(std::size_t line = 0; line < starts.size(); ++line) {
+        auto first = lines.locate(starts[line]);
+        REQUIRE(first.line == line);
+        REQUIRE(first.column == 0);
+
+        // the newline ending the line is still on it
+        auto last = lines.locate(starts[line] + static_cast<std::uint32_t>(line));
+        REQUIRE(last.line == line);
+        REQUIRE(last.column == line);
+    }
+
+    WHEN("The offset is the end of the source") {
+        auto end = lines.locate(static_cast<std::uint32_t>(source.size()));
+        REQUIRE(end.line == starts.size());
+        REQUIRE(end.column == 0);
+    }
+
+    WHEN("The source is empty") {
+        as::line_index empty("");
+        REQUIRE(empty.lines() == 1);
+        REQUIRE(empty.locate(0).line == 0);
+    }
+}
+
+TEST_CASE("Lexer treats tabs and carriage returns as whitespace", "[lexer]") {
+    using tk = as::token_type;
+
+    as::lexer lexer;
+    auto output = lexer.lex("\tadd\t$t0,\t$t1, $t2\r\nj\tmain\r\n");
+
+    REQUIRE(output.has_value());
+
+    auto& tokens = output.value();
+    REQUIRE(tokens.size() == 10);
+    REQUIRE(std::get<std::string>(tokens.at(0).attribute()) == "add");
+    REQUIRE(tokens.at(5).type() == tk::REGISTER);
+    REQUIRE(tokens.at(6).type() == tk::NEW_LINE);
+    REQUIRE(std::get<std::string>(tokens.at(8).attribute()) == "main");
+}
+
+TEST_CASE("Lexer streams a source fed in chunks", "[lexer]") {
+    const std::string input =
+        "main: add $t0, $t1, $t2 # comment\n"
+        ".data\n"
+        "msg: .asciiz \"a string\nover two lines\"\n"
+        "lw $t1, 4($sp)\n"
+        "j main";
+
+    as::lexer lexer;
+    auto expected = lexer.lex(input);
+    REQUIRE(expected.has_value());
+
+    as::diagnostic_list diagnostics;
+
+    for(auto storage : { as::attribute_storage::OWNED, as::attribute_storage::BORROWED }) {
+        for(std::size_t chunk_size = 1; chunk_size <= input.size(); ++chunk_size) {
+            std::vector<as::token> tokens;
+
+            // borrowed symbols are only valid within the callback
+            as::lexer::stream stream([&tokens](as::token&& tk) {
+                tokens.emplace_back(tk.type(), tk.offset(), tk.attribute());
+            }, diagnostics, storage);
+
+            for(std::size_t pos = 0; pos < input.size(); pos += chunk_size) {
+                std::string chunk = input.substr(pos, chunk_size);
+                REQUIRE(stream.feed(chunk));
+            }
+
+            REQUIRE(stream.finish());
+            REQUIRE(tokens.size() == expected.value().size());
+
+            for(std::size_t i = 0; i < tokens.size(); ++i) {
+                REQUIRE(tokens.at(i).type() == expected.value().at(i).type());
+                REQUIRE(tokens.at(i).offset() == expected.value().at(i).offset());
+                REQUIRE(tokens.at(i).attribute() == expected.value().at(i).attribute());
+            }
+        }
+    }
+
+    WHEN("Owned tokens are kept across several feeds") {
+        std::vector<as::token> tokens;
+        as::lexer::stream stream([&tokens](as::token&& tk) { tokens.push_back(std::move(tk)); }, diagnostics);
+
+        REQUIRE(stream.feed("main: add $t0, $t1, $t2\n"));
+        REQUIRE(stream.feed("msg: .asciiz \"text\"\n"));
+        REQUIRE(stream.feed("j main\n"));
+        REQUIRE(stream.finish());
+
+        THEN("They own their symbols, which outlive the stream's buffer") {
+            REQUIRE(tokens.size() == 15);
+            REQUIRE(tokens.at(0).owns_symbol());
+            REQUIRE(tokens.at(0).symbol() == "main");
+            REQUIRE(tokens.at(1).symbol() == "add");
+            REQUIRE(tokens.at(8).symbol() == "msg");
+            REQUIRE(tokens.at(10).symbol() == "text");
+            REQUIRE(tokens.at(13).symbol() == "main");
+        }
+    }
+
+    WHEN("An invalid token is fed") {
+        std::size_t count = 0;
+        as::lexer::stream stream([&count](as::token&&) { ++count; }, diagnostics);
+
+        REQUIRE(stream.feed("add $t0\n.da"));
+        REQUIRE(!stream.feed("ta/\n"));
+
+        THEN("It is reported to the sink with its line") {
+            REQUIRE(diagnostics.diagnostics().size() == 1);
+            REQUIRE(diagnostics.diagnostics()[0].line == 1);
+        }
+
+        THEN("The stream stops") {
+            REQUIRE(!stream.feed("add\n"));
+            REQUIRE(!stream.finish());
+        }
+
+        THEN("Only the lines before it were passed on") {
+            REQUIRE(count == 3);
+        }
+    }
+
+    WHEN("The stream resumes just under 4 GiB into the source") {
+        constexpr std::size_t base = as::lexer::max_source_size - 20;
+
+        std::vector<as::token> tokens;
+        as::lexer::stream stream([&tokens](as::token&& tk) { tokens.push_back(std::move(tk)); },
+                                 diagnostics, as::attribute_storage::OWNED, nullptr, base);
+
+        REQUIRE(stream.feed("add $t0, $t1, $t2\n"));
+
+        THEN("Its tokens are at offsets from the start of the source") {
+            REQUIRE(tokens.front().offset() == base);
+            REQUIRE(tokens.back().offset() == base + 17);
+        }
+
+        THEN("An error is located past the base") {
+            REQUIRE(!stream.feed("x/\n"));
+            REQUIRE(diagnostics.diagnostics().size() == 1);
+            REQUIRE(diagnostics.diagnostics()[0].offset == base + 18);
+            REQUIRE(diagnostics.diagnostics()[0].line == 1);
+            REQUIRE(diagnostics.diagnostics()[0].column == 0);
+        }
+
+        THEN("Feeding past 4 GiB is rejected rather than wrapping") {
+            REQUIRE(!stream.feed("j main\n"));
+            REQUIRE(diagnostics.diagnostics().size() == 1);
+            REQUIRE(diagnostics.diagnostics()[0].offset == base + 18);
+            REQUIRE(diagnostics.diagnostics()[0].reason == "Source is too large, it must be smaller than 4 GiB");
+            REQUIRE(!stream.finish());
+        }
+    }
+}
+
+TEST_CASE("Parallel lexing matches lexing in one pass", "[lexer]") {
+    using tk = as::token_type;
+
+    std::string statements;
+    while(statements.size() < (512 << 10)) {
+        statements += "main: add # comment\n.data\nj main\n";
+    }
+
+    // a string spanning many lines, so it crosses where the input is cut
+    std::string text;
+    while(text.size() < (256 << 10)) {
+        text += "text\n";
+    }
+
+    const std::string input = statements + ".asciiz \"" + text + "\"\n" + statements + "j main";
+
+    as::lexer lexer;
+    auto expected = lexer.lex(input);
+    REQUIRE(expected.has_value());
+
+    auto same_token = [](const as::token& a, const as::token& b) {
+        return a.type() == b.type() && a.offset() == b.offset() && a.attribute() == b.attribute();
+    };
+
+    as::diagnostic_list diagnostics;
+
+    for(unsigned threads : { 1u, 2u, 4u, 5u }) {
+        auto output = lexer.lex_parallel(input, diagnostics, threads);
+        REQUIRE(output.has_value());
+        REQUIRE(output.value().size() == expected.value().size());
+        REQUIRE(std::equal(output.value().begin(), output.value().end(), expected.value().begin(), same_token));
+    }
+
+    WHEN("An invalid token is in a later slice") {
+        auto output = lexer.lex_parallel(input + "\n.da/ta\n", diagnostics, 4);
+
+        THEN("Lexing fails, and the error is reported to the sink") {
+            REQUIRE(!output.has_value());
+            REQUIRE(diagnostics.diagnostics().size() == 1);
+            REQUIRE(diagnostics.diagnostics()[0].line == std::count(input.begin(), input.end(), '\n') + 1);
+        }
+    }
+
+    THEN("The string is a single token") {
+        auto output = lexer.lex_parallel(input, diagnostics, 4);
+        auto is_text = [&text](const as::token& t) { return t.type() == tk::LITERAL_STRING && t.symbol() == text; };
+
+        REQUIRE(std::count_if(output.value().begin(), output.value().end(), is_text) == 1);
+    }
+}
+
+TEST_CASE("Lexer interns symbols", "[lexer]") {
+    using tk = as::token_type;
+
+    const std::string input = "main: add $t0, $t1, $t2\n.text\nj main\nadd $t0, $t1, $t2\n.asciiz \"main\"\n";
+
+    as::interner symbols;
+    as::lexer lexer;
+    auto output = lexer.lex(input, as::attribute_storage::OWNED, &symbols);
+
+    REQUIRE(output.has_value());
+
+    auto& tokens = output.value();
+
+    THEN("Each distinct symbol gets one id") {
+        REQUIRE(symbols.size() == 5);
+        REQUIRE(tokens.at(0).symbol_id() == tokens.at(11).symbol_id());
+        REQUIRE(tokens.at(1).symbol_id() == tokens.at(13).symbol_id());
+        REQUIRE(tokens.at(0).symbol_id() != tokens.at(1).symbol_id());
+        REQUIRE(symbols.name(tokens.at(10).symbol_id().value()) == "j");
+    }
+
+    THEN("Symbols reference the interner, not the input") {
+        REQUIRE(tokens.at(11).type() == tk::LABEL);
+        REQUIRE(tokens.at(11).symbol() == "main");
+        REQUIRE(tokens.at(11).symbol().data() == symbols.name(tokens.at(0).symbol_id().value()).data());
+    }
+
+    THEN("String literals aren't symbols") {
+        REQUIRE(tokens.at(21).type() == tk::LITERAL_STRING);
+        REQUIRE(!tokens.at(21).symbol_id().has_value());
+    }
+
+    THEN("Parallel lexing and streaming assign the same ids") {
+        as::diagnostic_list diagnostics;
+
+        as::interner parallel_symbols;
+        auto parallel = lexer.lex_parallel(input, diagnostics, 2, as::attribute_storage::OWNED, &parallel_symbols);
+
+        as::interner stream_symbols;
+        std::vector<std::optional<std::uint32_t>> stream_ids;
+        as::lexer::stream stream([&stream_ids](as::token&& tk) { stream_ids.push_back(tk.symbol_id()); },
+                                 diagnostics, as::attribute_storage::OWNED, &stream_symbols);
+
+        for(char ch : input) {
+            REQUIRE(stream.feed(std::string_view(&ch, 1)));
+        }
+
+        REQUIRE(stream.finish());
+        REQUIRE(stream_ids.size() == tokens.size());
+
+        for(std::size_t i = 0; i < tokens.size(); ++i) {
+            REQUIRE(parallel.value().at(i).symbol_id() == tokens.at(i).symbol_id());
+            REQUIRE(stream_ids.at(i) == tokens.at(i).symbol_id());
+        }
+    }
+}
+
+TEST_CASE("Token streams store tokens as parallel arrays", "[lexer]") {
+    using tk = as::token_type;
+
+    REQUIRE(as::token_stream::bytes_per_token(false) < 12);
+    REQUIRE(as::token_stream::bytes_per_token(true) == 25);
+
+    const std::string source = "main";
+
+    as::token_stream tokens;
+    tokens.push_back(as::token(tk::MNEMONIC, 1, "add"));
+    tokens.push_back(as::token(tk::REGISTER, 1, 8));
+    tokens.push_back(as::token(tk::LITERAL_NUMBER, 1, -100));
+    tokens.push_back(as::token::borrowing(tk::LABEL, 1, source));
+    tokens.push_back(as::token::interned(tk::LABEL, 1, { 7, source }));
+    tokens.push_back(as::token(tk::NEW_LINE, 1));
+
+    REQUIRE(tokens.size() == 6);
+
+    THEN("Tokens read back as they were pushed") {
+        REQUIRE(tokens.at(0).type() == tk::MNEMONIC);
+        REQUIRE(tokens.at(0).offset() == 1);
+        REQUIRE(std::get<std::string>(tokens.at(0).attribute()) == "add");
+        REQUIRE(tokens.at(1).number() == 8);
+        REQUIRE(tokens.at(2).number() == -100);
+        REQUIRE(tokens.at(3).symbol().data() == source.data());
+        REQUIRE(tokens.at(4).symbol_id() == 7u);
+        REQUIRE(tokens.back().type() == tk::NEW_LINE);
+    }
+
+    THEN("Types are found without reading the tokens") {
+        REQUIRE(tokens.find(tk::LABEL) == 3);
+        REQUIRE(tokens.find(tk::LABEL, 4) == 4);
+        REQUIRE(tokens.find(tk::NEW_LINE) == 5);
+        REQUIRE(tokens.find(tk::COMMA) == tokens.size());
+    }
+
+    THEN("Appending a stream keeps its symbols") {
+        as::token_stream more;
+        more.push_back(as::token(tk::LITERAL_STRING, 2, "text"));
+        more.push_back(as::token(tk::NEW_LINE, 2));
+
+        tokens.append(std::move(more));
+        tokens.pop_back();
+
+        REQUIRE(tokens.size() == 7);
+        REQUIRE(tokens.back().symbol() == "text");
+        REQUIRE(tokens.at(3).symbol() == "main");
+
+        std::vector<as::token> copied(tokens.begin(), tokens.end());
+        REQUIRE(copied.at(6).offset() == 2);
+    }
+}
+
+TEST_CASE("Lexer parses registers and numbers", "[lexer]") {
+    using tk = as::token_type;
+
+    as::lexer lexer;
+
+    auto first_attribute = [&lexer](const std::string& input) -> std::optional<std::int32_t> {
+        auto output = lexer.lex(input);
+
+        if(!output.has_value()) {
+            return std::nullopt;
+        }
+
+        return output.value().at(0).number();
+    };
+
+    WHEN("Registers are numbered") {
+        REQUIRE(first_attribute("$0\n") == 0);
+        REQUIRE(first_attribute("$31\n") == 31);
+        REQUIRE(first_attribute("$07\n") == 7);
+        REQUIRE(!first_attribute("$32\n").has_value());
+        REQUIRE(!first_attribute("$3a\n").has_value());
+    }
+
+    WHEN("Registers are named") {
+        REQUIRE(first_attribute("$zero\n") == 0);
+        REQUIRE(first_attribute("$ra\n") == 31);
+        REQUIRE(!first_attribute("$xx\n").has_value());
+    }
+
+    WHEN("Numbers are in different bases") {
+        REQUIRE(first_attribute("100\n") == 100);
+        REQUIRE(first_attribute("-100\n") == -100);
+        REQUIRE(first_attribute("+7\n") == 7);
+        REQUIRE(first_attribute("0\n") == 0);
+        REQUIRE(first_attribute("0x1F\n") == 0x1F);
+        REQUIRE(first_attribute("-0x10\n") == -16);
+        REQUIRE(first_attribute("0b101\n") == 5);
+        REQUIRE(first_attribute("017\n") == 15);
+        REQUIRE(first_attribute("0xFFFFFFFF\n") == -1);
+        REQUIRE(first_attribute("-2147483648\n") == -2147483648LL);
+    }
+
+    WHEN("Numbers are malformed or out of range") {
+        REQUIRE(!first_attribute("0x\n").has_value());
+        REQUIRE(!first_attribute("08\n").has_value());
+        REQUIRE(!first_attribute("0b2\n").has_value());
+        REQUIRE(!first_attribute("12ab\n").has_value());
+        REQUIRE(!first_attribute("--1\n").has_value());
+        REQUIRE(!first_attribute("0x100000000\n").has_value());
+        REQUIRE(!first_attribute("-2147483649\n").has_value());
+    }
+
+    WHEN("An offset is followed by a base register") {
+        auto output = lexer.lex("lw $t1, 0x10($t0)\n");
+
+        REQUIRE(output.has_value());
+        REQUIRE(output.value().at(3).type() == tk::OFFSET);
+        REQUIRE(output.value().at(3).number() == 16);
+        REQUIRE(output.value().at(4).type() == tk::BASE_REGISTER);
+        REQUIRE(output.value().at(4).number() == 8);
+    }
+}
+
+TEST_CASE("One lexer can be shared between threads", "[lexer]") {
+
+    using tk = as::token_type;
+
+    const as::lexer lexer;
+
+    // every thread lexes its own snippets, all through the same lexer
+    constexpr int thread_count = 4;
+    constexpr int snippets_per_thread = 500;
+
+    std::vector<int> failures(thread_count, 0);
+    std::vector<std::thread> workers;
+
+    for(int t = 0; t < thread_count; ++t) {
+        workers.emplace_back([&lexer, &failures, t] {
+            for(int i = 0; i < snippets_per_thread; ++i) {
+                int imm = t * snippets_per_thread + i;
+                std::string src = "addi $t0, $t1, " + std::to_string(imm) + "\n";
+
+                // a bad snippet in between must not affect the next call
+                if(i % 100 == 0 && lexer.lex("add $xx\n").has_value()) {
+                    ++failures[t];
+                }
+
+                auto output = lexer.lex(src);
+
+                if(!output.has_value()
+                   || output.value().size() != 7
+                   || output.value().at(0).type() != tk::MNEMONIC
+                   || output.value().at(0).symbol() != "addi"
+                   || output.value().at(5).number() != imm) {
+                    ++failures[t];
+                }
+            }
+        });
+    }
+
+    for(auto& worker : workers) {
+        worker.join();
+    }
+
+    REQUIRE(std::all_of(failures.begin(), failures.end(), [](int f) { return f == 0; }));
+}
+
+TEST_CASE("Lexer relexes only the lines that changed", "[lexer]") {
+    using tk = as::token_type;
+
+    as::lexer lexer;
+
+    auto join = [](const std::vector<std::string>& lines) {
+        std::string source;
+
+        for(auto& line : lines) {
+            source += line + "\n";
+        }
+
+        return source;
+    };
+
+    auto same_token = [](const as::token& a, const as::token& b) {
+        return a.type() == b.type() && a.offset() == b.offset() && a.attribute() == b.attribute();
+    };
+
+    std::vector<std::string> lines = {
+        ".text",
+        "main: add $t0, $t1, $t2 # comment",
+        "addi $t0, $t0, 100",
+        ".data",
+        "msg: .asciiz \"first",
+        "second\"",
+        "j main"
+    };
+
+    std::string source = join(lines);
+    auto tokens = lexer.lex(source);
+    REQUIRE(tokens.has_value());
+
+    as::diagnostic_list diagnostics;
+
+    // index of the first token on a line, the lines before it are the same in the old and new source
+    auto line_token = [&](std::size_t line) {
+        auto begin = join({ lines.begin(), lines.begin() + line }).size();
+        return tokens.value().lower_bound_offset(static_cast<std::uint32_t>(begin));
+    };
+
+    // replace count lines at first with replacement, relex, and check it matches lexing the new source
+    auto edit = [&](std::size_t first, std::size_t count, const std::vector<std::string>& replacement) {
+        lines.erase(lines.begin() + first, lines.begin() + first + count);
+        lines.insert(lines.begin() + first, replacement.begin(), replacement.end());
+        source = join(lines);
+
+        REQUIRE(lexer.relex(tokens.value(), source, { first, count, replacement.size() }, diagnostics));
+
+        auto expected = lexer.lex(source);
+        REQUIRE(expected.has_value());
+        REQUIRE(tokens.value().size() == expected.value().size());
+        REQUIRE(std::equal(tokens.value().begin(), tokens.value().end(), expected.value().begin(), same_token));
+    };
+
+    WHEN("A line is changed") {
+        edit(2, 1, { "addi $t0, $t0, 200" });
+        REQUIRE(tokens.value().at(line_token(2) + 5).number() == 200);
+    }
+
+    WHEN("Lines are inserted and removed") {
+        edit(1, 0, { "sub $s0, $s1, $s2", "", "# comment" });
+        edit(0, 2, { });
+        edit(3, 1, { "or $t0, $t0, $t0", "and $t0, $t0, $t0" });
+    }
+
+    WHEN("A line inside a string spanning lines is changed") {
+        edit(5, 1, { "third\"" });
+    }
+
+    WHEN("A string spanning lines is opened or closed") {
+        // the quote in the comment closes a string opened before it, so the source is valid either way
+        edit(4, 2, { "msg: .asciiz \" \" #\"" });
+        edit(2, 1, { ".asciiz \"open" });
+        edit(2, 1, { ".asciiz \"closed\"" });
+        edit(4, 1, { "msg: .asciiz \"first\"" });
+    }
+
+    WHEN("Tokens are popped and pushed after a line is changed") {
+        edit(2, 1, { "addi $t0, $t0, 200" });
+
+        auto expected = lexer.lex(source);
+
+        for(int i = 0; i < 3; ++i) {
+            tokens.value().pop_back();
+            expected.value().pop_back();
+        }
+
+        for(auto& tks : { &tokens.value(), &expected.value() }) {
+            tks->push_back(as::token(tk::MNEMONIC, 0, "jal"));
+            tks->push_back(as::token(tk::LABEL, 0, "start"));
+        }
+
+        THEN("The symbols of the tokens left are those they were lexed with") {
+            REQUIRE(tokens.value().size() == expected.value().size());
+            REQUIRE(tokens.value().at(line_token(2)).symbol() == "addi");
+            REQUIRE(std::equal(tokens.value().begin(), tokens.value().end(), expected.value().begin(), same_token));
+        }
+    }
+
+    WHEN("A line is changed over and over") {
+        auto symbols = tokens.value().symbol_count();
+        auto owned = tokens.value().owned_bytes();
+
+        for(int i = 0; i < 1000; ++i) {
+            edit(1, 1, { i % 2 == 0 ? "start: sub $t0, $t1, $t2" : "main: add $t0, $t1, $t2 # comment" });
+        }
+
+        THEN("The symbols of the removed tokens are freed") {
+            REQUIRE(tokens.value().symbol_count() == symbols);
+            REQUIRE(tokens.value().owned_bytes() <= 2 * owned);
+        }
+    }
+
+    WHEN("The last line has no newline") {
+        source.pop_back();
+        tokens = lexer.lex(source);
+
+        lines.back() = "jal main";
+        std::string edited = join(lines);
+        edited.pop_back();
+
+        REQUIRE(lexer.relex(tokens.value(), edited, { lines.size() - 1, 1, 1 }, diagnostics));
+        REQUIRE(tokens.value().back().type() == tk::NEW_LINE);
+        REQUIRE(tokens.value().at(tokens.value().size() - 3).symbol() == "jal");
+    }
+
+    WHEN("The changed line has an invalid token") {
+        auto size = tokens.value().size();
+        lines[2] = "addi $xx, $t0, 100";
+
+        THEN("Relexing fails and the tokens are left as they were") {
+            REQUIRE(!lexer.relex(tokens.value(), join(lines), { 2, 1, 1 }, diagnostics));
+            REQUIRE(tokens.value().size() == size);
+            REQUIRE(tokens.value().at(line_token(2) + 5).number() == 100);
+
+            REQUIRE(diagnostics.diagnostics().size() == 1);
+            REQUIRE(diagnostics.diagnostics()[0].line == 2);
+        }
+    }
+
+    WHEN("Symbols are interned") {
+        as::interner symbols;
+        tokens = lexer.lex(source, as::attribute_storage::OWNED, &symbols);
+
+        lines[6] = "j msg";
+        REQUIRE(lexer.relex(tokens.value(), join(lines), { 6, 1, 1 }, diagnostics, as::attribute_storage::OWNED,
+                            &symbols));
+
+        auto j = tokens.value().at(line_token(6) + 1);
+        REQUIRE(j.symbol() == "msg");
+        REQUIRE(j.symbol_id() == symbols.find("msg"));
+    }
+}
+
+TEST_CASE("Lexer produces statements lazily", "[lexer]") {
+    using tk = as::token_type;
+
+    as::lexer lexer;
+
+    const std::string input =
+        ".text\n"
+        "main: add $t0, $t1, $t2 # comment\n"
+        "\n"
+        "# only a comment\n"
+        "msg: .asciiz \"spans\n"
+        "two lines\"\n"
+        "j main";
+
+    auto expected = lexer.lex(input);
+    REQUIRE(expected.has_value());
+
+    as::diagnostic_list diagnostics;
+
+    auto same_token = [](const as::token& a, const as::token& b) {
+        return a.type() == b.type() && a.offset() == b.offset() && a.attribute() == b.attribute();
+    };
+
+    THEN("The statements are the tokens lex() returns, split after each NEW_LINE") {
+        std::vector<std::size_t> sizes;
+        std::size_t index = 0;
+
+        for(auto& statement : lexer.statements(input, diagnostics)) {
+            sizes.push_back(statement.size());
+            REQUIRE(statement.back().type() == tk::NEW_LINE);
+
+            // skip the lines without tokens in between
+            while(expected.value().type(index) == tk::NEW_LINE) {
+                ++index;
+            }
+
+            REQUIRE(std::equal(statement.begin(), statement.end(), expected.value().begin() + index, same_token));
+            index += statement.size();
+        }
+
+        REQUIRE(sizes == std::vector<std::size_t>{ 2, 8, 4, 3 });
+        REQUIRE(index == expected.value().size());
+    }
+
+    WHEN("An invalid token is found") {
+        std::vector<as::token_type> first_types;
+
+        std::vector<std::size_t> reported;
+
+        for(auto& statement : lexer.statements("add $t0\nadd $xx\nadd $t0\n", diagnostics)) {
+            first_types.push_back(statement.type(0));
+            reported.push_back(diagnostics.diagnostics().size());
+        }
+
+        THEN("Its statement is replaced by it, and lexing goes on") {
+            REQUIRE(first_types == std::vector<as::token_type>{ tk::MNEMONIC, tk::INVALID_TOKEN, tk::MNEMONIC });
+        }
+
+        THEN("It is reported to the sink before its statement is produced") {
+            REQUIRE(reported == std::vector<std::size_t>{ 0, 1, 1 });
+            REQUIRE(diagnostics.diagnostics()[0].line == 1);
+        }
+    }
+
+    WHEN("The source is empty") {
+        auto statements = lexer.statements("", diagnostics);
+        REQUIRE(statements.begin() == statements.end());
+    }
+}
+
+TEST_CASE("Lexer reports every error in one pass", "[lexer]") {
+    using tk = as::token_type;
+
+    as::lexer lexer;
+    std::vector<as::diagnostic> diagnostics;
+
+    const std::string source =
+        "add $t0, $t1, $t2\n"
+        "add $xx, $t1, $t2 # comment\n"
+        "  .da/ta\n"
+        "lw $t1, 4($sp)\n"
+        "addi $t0, $t0, 0x\n"
+        "j main\n"
+        "add: j main";
+
+    auto tokens = lexer.lex(source, diagnostics);
+
+    THEN("Each error has its line, column and reason") {
+        REQUIRE(diagnostics.size() == 4);
+
+        REQUIRE(diagnostics[0].line == 1);
+        REQUIRE(diagnostics[0].column == 5);
+        REQUIRE(diagnostics[0].reason == "Invalid register near 'xx'");
+
+        REQUIRE(diagnostics[1].line == 2);
+        REQUIRE(diagnostics[1].column == 3);
+
+        // found by the newline ending the number
+        REQUIRE(diagnostics[2].line == 4);
+        REQUIRE(diagnostics[2].column == 15);
+        REQUIRE(diagnostics[2].reason == "Invalid number literal near '0x'");
+
+        REQUIRE(diagnostics[3].line == 6);
+        REQUIRE(diagnostics[3].column == 0);
+    }
+
+    THEN("Each statement with an error is replaced by an invalid token") {
+        as::line_index lines(source);
+
+        auto line_types = [&](std::size_t line) {
+            std::vector<as::token_type> types;
+
+            for(std::size_t i = 0; i < tokens.size(); ++i) {
+                if(lines.locate(tokens.offset(i)).line == line) {
+                    types.push_back(tokens.type(i));
+                }
+            }
+
+            return types;
+        };
+
+        for(std::size_t line : { 1, 2, 4, 6 }) {
+            REQUIRE(line_types(line) == std::vector<as::token_type>{ tk::INVALID_TOKEN, tk::NEW_LINE });
+        }
+
+        REQUIRE(tokens.at(tokens.lower_bound_offset(diagnostics[0].offset)).symbol() == diagnostics[0].reason);
+
+        REQUIRE(line_types(3).front() == tk::MNEMONIC);
+        REQUIRE(line_types(5) == std::vector<as::token_type>{ tk::MNEMONIC, tk::LABEL, tk::NEW_LINE });
+    }
+
+    THEN("Lexing without diagnostics fails") {
+        REQUIRE(!lexer.lex("add $xx\nadd $yy\n").has_value());
+    }
+
+    THEN("Lexing into a sink fails, and reports each error located") {
+        as::diagnostic_list sink;
+
+        REQUIRE(!lexer.lex(source, sink).has_value());
+        REQUIRE(sink.has_errors());
+        REQUIRE(sink.diagnostics().size() == 4);
+        REQUIRE(sink.diagnostics()[2].line == 4);
+        REQUIRE(sink.diagnostics()[2].column == 15);
+    }
+
+    THEN("A printer locates the errors in the source") {
+        std::ostringstream out;
+        as::diagnostic_printer printer(out, source);
+
+        printer.report(as::severity::ERROR, diagnostics[0].offset, [] { return std::string("Invalid register"); });
+        printer.report(as::severity::WARNING, 0, [] { return std::string("Suspicious"); });
+
+        REQUIRE(out.str() == "Invalid register at line 1, column 5\nwarning: Suspicious at line 0, column 0\n");
+    }
+}
+
+TEST_CASE("Lexer rejects characters and literals that aren't a token", "[lexer]") {
+    using tk = as::token_type;
+
+    as::lexer lexer;
+
+    auto lex = [&lexer](const std::string& input, std::vector<as::diagnostic>& diagnostics) {
+        auto tokens = lexer.lex(input, diagnostics);
+        std::vector<as::token_type> types;
+
+        for(std::size_t i = 0; i < tokens.size(); ++i) {
+            types.push_back(tokens.type(i));
+        }
+
+        return types;
+    };
+
+    WHEN("A character can't start a token") {
+        std::vector<as::diagnostic> diagnostics;
+        auto types = lex("add $t0, $t1, $t2 @@@ ;;\nj main\n", diagnostics);
+
+        REQUIRE(diagnostics.size() == 1);
+        REQUIRE(diagnostics[0].column == 18);
+        REQUIRE(diagnostics[0].reason == "Unexpected character near '@'");
+        REQUIRE(types == std::vector<as::token_type>{ tk::INVALID_TOKEN, tk::NEW_LINE,
+                                                      tk::MNEMONIC, tk::LABEL, tk::NEW_LINE });
+    }
+
+    WHEN("A character is in the middle of a token") {
+        std::vector<as::diagnostic> diagnostics;
+        lex("main@: j main\nadd $t0;\naddi $t0, $t0, 4;\nlw $t0, 4($sp\nlw $t0, 4(sp)\n", diagnostics);
+
+        REQUIRE(diagnostics.size() == 5);
+        REQUIRE(diagnostics[0].reason == "Unexpected character near 'main@'");
+        REQUIRE(diagnostics[1].reason == "Unexpected character near 't0;'");
+        REQUIRE(diagnostics[2].reason == "Unexpected character near '4;'");
+        REQUIRE(diagnostics[3].reason == "Unexpected character near 'sp'");
+        REQUIRE(diagnostics[4].line == 4);
+    }
+
+    WHEN("An offset has no number before its base register") {
+        std::vector<as::diagnostic> diagnostics;
+        auto types = lex("lw $t0, ($sp)", diagnostics);
+
+        REQUIRE(diagnostics.size() == 1);
+        REQUIRE(diagnostics[0].column == 8);
+        REQUIRE(types == std::vector<as::token_type>{ tk::INVALID_TOKEN, tk::NEW_LINE });
+    }
+
+    WHEN("A literal is still open at the end of the source") {
+        for(const std::string ending : { "", "\n", "\nmore lines\n" }) {
+            std::vector<as::diagnostic> diagnostics;
+            auto types = lex("j main\nx: .asciiz \"unterminated" + ending, diagnostics);
+
+            REQUIRE(diagnostics.size() == 1);
+            REQUIRE(diagnostics[0].line == 1);
+            REQUIRE(diagnostics[0].reason == "Unterminated string literal");
+            REQUIRE(types == std::vector<as::token_type>{ tk::MNEMONIC, tk::LABEL, tk::NEW_LINE,
+                                                          tk::INVALID_TOKEN, tk::NEW_LINE });
+        }
+
+        std::vector<as::diagnostic> diagnostics;
+        lex(".byte 'a", diagnostics);
+
+        REQUIRE(diagnostics.size() == 1);
+        REQUIRE(diagnostics[0].reason == "Unterminated character literal");
+    }
+
+    WHEN("A literal is still open when a stream finishes") {
+        as::diagnostic_list diagnostics;
+        as::lexer::stream stream([](as::token&&) { }, diagnostics);
+
+        REQUIRE(stream.feed("x: .asciiz \"open\n"));
+        REQUIRE(stream.feed("over lines\n"));
+        REQUIRE(!stream.finish());
+        REQUIRE(diagnostics.diagnostics().size() == 1);
+        REQUIRE(diagnostics.diagnostics()[0].reason == "Unterminated string literal");
+    }
+
+    WHEN("The statements of a source are lexed one at a time") {
+        as::diagnostic_list diagnostics;
+        std::size_t count = 0;
+
+        for(auto& statement : lexer.statements("j main\nx: .asciiz \"open", diagnostics)) {
+            count += statement.type(0) == tk::INVALID_TOKEN;
+        }
+
+        REQUIRE(count == 1);
+        REQUIRE(diagnostics.diagnostics().size() == 1);
+    }
+}
+
+TEST_CASE("Lexer can be profiled", "[lexer]") {
+    as::lexer lexer;
+    as::profiler profile;
+
+    const std::string input =
+        "main: add $t0, $t1, $t2 # comment\n"
+        "msg: .asciiz \"text\"\n";
+
+    as::diagnostic_list diagnostics;
+    auto tokens = lexer.lex(input, profile, diagnostics);
+    REQUIRE(tokens.has_value());
+
+    THEN("The tokens are the same as without profiling") {
+        REQUIRE(tokens.value().size() == lexer.lex(input).value().size());
+    }
+
+    THEN("Every character is either ticked or skipped") {
+        std::uint64_t characters = 0;
+
+        for(auto& state : profile.states()) {
+            characters += state.ticks + state.skipped_bytes;
+        }
+
+        REQUIRE(characters == input.size());
+    }
+
+    THEN("The states are named") {
+        REQUIRE(profile.state_name(0) == "BASE");
+        REQUIRE(profile.states().at(3).skipped_bytes == std::string(" comment").size());
+    }
 }
@@ -3,6 +3,7 @@
 //
 
 #define CATCH_CONFIG_RUNNER
+#define CATCH_CONFIG_NO_POSIX_SIGNALS
 #include <catch.hpp>
 
 int main(int argc, char* argv[]) {
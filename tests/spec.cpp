@@ -0,0 +1,47 @@
+//
+// Created by ocanty on 17/10/26.
+//
+
+#include <catch.hpp>
+#include "spec/directives.hpp"
+#include "spec/instruction_defs.hpp"
+#include "spec/registers.hpp"
+
+// the hashes are built at compile time, and can be used there too
+static_assert(as::spec::find_register("ra") == 31);
+static_assert(as::spec::find_directive("asciiz") == as::spec::directive::ASCIIZ);
+
+TEST_CASE("Perfect hashes find every key and nothing else", "[spec]") {
+    using namespace as::spec;
+
+    WHEN("Registers") {
+        for(std::size_t i = 0; i < registers.size(); ++i) {
+            REQUIRE(find_register(registers[i]) == i);
+        }
+
+        REQUIRE(!find_register("t10").has_value());
+        REQUIRE(!find_register("").has_value());
+        REQUIRE(!find_register("zer").has_value());
+    }
+
+    WHEN("Instructions") {
+        REQUIRE(instructions::count() > 0);
+
+        for(std::uint8_t i = 0; i < instructions::count(); ++i) {
+            REQUIRE(instructions::id(instructions::mnemonic(i)) == i);
+            REQUIRE(instructions::find(instructions::mnemonic(i)) == &instructions::at(i));
+        }
+
+        REQUIRE(instructions::exists("addiu"));
+        REQUIRE(!instructions::exists("addiux"));
+        REQUIRE(instructions::find("main") == nullptr);
+    }
+
+    WHEN("Directives") {
+        for(std::size_t i = 0; i < directives.size(); ++i) {
+            REQUIRE(find_directive(directives[i]) == static_cast<directive>(i));
+        }
+
+        REQUIRE(!find_directive("txt").has_value());
+    }
+}